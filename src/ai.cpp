@@ -24,6 +24,10 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "character.h"
+#include "skill.h"
+#include "binary_io.h"
+#include "lane_stats.h"
+#include "hero_ai.h"
 
 #include "ai.h"
 
@@ -46,5 +50,204 @@ CharacterSP Ai::character() const {
 }
 
 
+AiType Ai::type() const {
+	return AI_BASIC;
+}
+
+
 void Ai::play() {
 }
+
+
+void Ai::write(BinaryWriter& /*writer*/) const {
+}
+
+
+void Ai::read(BinaryReader& /*reader*/, const CharacterIndexMap& /*characters*/) {
+}
+
+
+AiAgent::AiAgent(CharacterSP character, CharacterWP* target)
+    : _character(character)
+    , _groups(character->node().get())
+    , _target(target)
+    , _lane(nullptr)
+    , _hero(nullptr)
+{
+}
+
+
+bool AiAgent::leaf(BtOp op, int arg) {
+	Character& c = *_character;
+	TextMoba* tm = c._textMoba;
+
+	switch(op) {
+	case BT_SELECTOR:
+	case BT_SEQUENCE:
+	case BT_NOT:
+	case BT_ALWAYS:
+	case BT_OP_COUNT:
+		break;
+
+	case BT_HP_BELOW:
+		return int(c.hp()) < int(c.maxHP()) * arg / 100;
+	case BT_RESTED:
+		return c.hp() == c.maxHP() && c.mana() == c.maxMana();
+	case BT_ENEMIES:
+		return int(_groups.count(c.enemyTeam())) >= arg;
+	case BT_ALLIED_REDSHIRTS:
+		return int(_groups.count(REDSHIRT, c.team())) >= arg;
+	case BT_ALLIED_TOWERS:
+		return int(_groups.count(BUILDING, c.team())) >= arg;
+	case BT_RANGE_IS:
+		return int(c.range()) == arg;
+	case BT_IN_ROW:
+		return c.place() == arg;
+	case BT_STATUS:
+		return _hero && _hero->_status == arg;
+	case BT_AT_FONXUS:
+		return c.node() == tm->fonxus(c.team());
+	case BT_OFF_LANE:
+		return _lane && c.node()->_lane != *_lane && c.node() != tm->fonxus(c.team());
+	case BT_ON_LANE:
+		return _lane && c.node()->_lane == *_lane;
+	case BT_PLAN_ELAPSED:
+		return _hero && _hero->_plan.type != PLAN_NONE
+		        && int(tm->_turn - _hero->_plan.start) >= arg;
+
+	case BT_SET_STATUS:
+		if(!_hero)
+			return false;
+		_hero->_status = HeroAi::Status(arg);
+		return true;
+	case BT_ATTACK_CLOSEST:
+		return attackClosest();
+	case BT_MOVE:
+		return move(arg == HeroAi::FORWARD);
+	case BT_GO_TO_FONXUS:
+		return moveToward(tm->fonxus(c.team()));
+	case BT_JOIN_LANE: {
+		if(!_lane)
+			return false;
+		MapNode* rally = tm->laneStats().rally(c.team(), *_lane, c.node().get());
+		return rally && moveToward(rally->shared_from_this());
+	}
+	case BT_SET_ROW:
+		if(c.place() == arg)
+			return false;
+		c.goToPlace(Place(arg));
+		return true;
+	case BT_USE_SKILL:
+		return useSkill(tm->behaviorTrees()._strings[arg]);
+	case BT_FOLLOW_PLAYER:
+		return followPlayer();
+	case BT_START_PLAN:
+		if(!_hero)
+			return false;
+		_hero->startPlan(AiPlanType(arg), tm->_turn);
+		return true;
+	}
+
+	return false;
+}
+
+
+bool AiAgent::attackClosest() {
+	CharacterSP target = _target->lock();
+
+	if(!target || !target->isAlive() ||
+	        _groups.distanceBetween(_character, target) > _character->range()) {
+		target = _groups.pickClosestEnemy(_character);
+	}
+
+	if(target) {
+		*_target = target;
+		_character->attack(target);
+	}
+
+	return bool(target);
+}
+
+
+bool AiAgent::followPlayer() {
+	Character& c = *_character;
+	TextMoba* tm = c._textMoba;
+
+	CharacterSP player = tm->player();
+	if(!player || !player->isAlive() || player->team() != c.team())
+		return false;
+	if(player->node() != c.node())
+		return moveToward(player->node());
+
+	CharacterSP target = tm->_playerTarget.lock();
+	if(target && target->isAlive() && target->node() == c.node()
+	        && _groups.distanceBetween(_character, target) <= c.range()) {
+		*_target = target;
+		c.attack(target);
+		return true;
+	}
+
+	return attackClosest();
+}
+
+
+bool AiAgent::move(bool forward) {
+	Team dir = forward? _character->enemyTeam(): _character->team();
+	MapNodeSP dest = _character->node()->destination(teamName(dir));
+	if(!dest && _lane) {
+		dest = _character->node()->destination(laneName(*_lane));
+	}
+
+	if(dest) {
+		_character->moveTo(dest);
+	}
+
+	return bool(dest);
+}
+
+
+bool AiAgent::moveToward(MapNodeSP dest) {
+	Character& c = *_character;
+	MapNodeSP hop = c._textMoba->nextHop(c.team(), c.node(), dest);
+	if(hop) {
+		c.moveTo(hop);
+	}
+
+	return bool(hop);
+}
+
+
+bool AiAgent::useSkill(const String& id) {
+	Character& c = *_character;
+
+	SkillSP skill;
+	for(const SkillSP& s: c.skills()) {
+		if(s->id() == id)
+			skill = s;
+	}
+	if(!skill || !skill->usable())
+		return false;
+
+	// Single target skills hit the closest enemy, or heal the caster.
+	CharacterVector targets;
+	Team team = skill->targetTeam();
+	if(skill->target() == SINGLE) {
+		CharacterSP target = (team == c.team())?
+		                         _character: _groups.pickClosestEnemy(_character, skill->range());
+		if(target)
+			targets = skill->targets(target);
+	}
+	else if(skill->target() == ANY_ROW) {
+		targets = skill->targets(_groups.count(team, FRONT)? FRONT: BACK);
+	}
+	else {
+		targets = skill->targets();
+	}
+
+	if(targets.empty())
+		return false;
+
+	c.setMana(c.mana() - skill->manaCost());
+	skill->useOn(targets);
+	return true;
+}
@@ -25,9 +25,21 @@
 
 #include <lair/core/lair.h>
 
+#include "map_node.h"
+#include "behavior_tree.h"
+
 #include "text_moba.h"
 
 
+enum AiType {
+	AI_BASIC,
+	AI_HERO,
+	AI_REDSHIRT,
+	AI_TOWER,
+	AI_SEARCH_HERO,
+};
+
+
 class Ai {
 public:
 	Ai(CharacterSP character);
@@ -35,11 +47,43 @@ public:
 
 	CharacterSP character() const;
 
+	virtual AiType type() const;
+
 	virtual void play();
 
+	// Save / load the AI state. Other characters are referenced by index.
+	virtual void write(BinaryWriter& writer) const;
+	virtual void read(BinaryReader& reader, const CharacterIndexMap& characters);
+
 public:
 	CharacterWP _character;
 };
 
 
+class HeroAi;
+
+// Plays the behavior tree leaves (see BtOp) with a character. The groups are
+// computed once, when the agent is created. SimModel has the same leaves.
+class AiAgent {
+public:
+	AiAgent(CharacterSP character, CharacterWP* target);
+
+	bool leaf(BtOp op, int arg);
+
+	bool attackClosest();
+	bool followPlayer();
+	bool move(bool forward);
+	bool moveToward(MapNodeSP dest);
+	bool useSkill(const lair::String& id);
+
+public:
+	CharacterSP     _character;
+	CharacterGroups _groups;
+	CharacterWP*    _target;
+	// Null if the AI has no lane / is not a hero.
+	const Lane*     _lane;
+	HeroAi*         _hero;
+};
+
+
 #endif
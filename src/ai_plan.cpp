@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "hero_ai.h"
+
+#include "ai_plan.h"
+
+
+using namespace lair;
+
+
+namespace {
+
+const AiPlanStep healSteps[] = {
+    { BT_GO_TO_FONXUS,   0, BT_AT_FONXUS, 0, false },
+    { BT_ATTACK_CLOSEST, 0, BT_RESTED,    0, false },
+    { BT_JOIN_LANE,      0, BT_ON_LANE,   0, false },
+};
+
+const AiPlanStep followSteps[] = {
+    { BT_FOLLOW_PLAYER, 0, BT_PLAN_ELAPSED, 10, false },
+};
+
+}
+
+
+// Indexed by AiPlanType.
+const AiPlan aiPlans[PLAN_COUNT] = {
+    { "none",   BT_OP_COUNT, 0, nullptr, 0 },
+    { "heal",   BT_OP_COUNT, 0, healSteps, 3 },
+    // Low health heroes go heal instead.
+    { "follow", BT_STATUS, HeroAi::BACK_TO_BASE, followSteps, 1 },
+};
+
+
+int findAiPlan(const String& name) {
+	for(int i = 0; i < PLAN_COUNT; ++i) {
+		if(name == aiPlans[i].name)
+			return i;
+	}
+	return -1;
+}
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_AI_PLAN_H_
+#define LD41_AI_PLAN_H_
+
+
+#include <lair/core/lair.h>
+
+#include "behavior_tree.h"
+
+
+// Multi-turn plans of the AI heroes, written as coroutines: each step plays
+// its action every turn until its wake condition holds, then the plan
+// resumes at the next step. A suspended plan costs one condition and one
+// action per turn, with no state to re-derive. Conditions and actions are
+// behavior tree leaves, so that TextMoba and SimModel play plans the same
+// way.
+
+enum AiPlanType {
+	PLAN_NONE,
+	// Walk to the fonxus, wait there until healed, go back to the lane.
+	PLAN_HEAL,
+	// Follow the player for a few turns and attack their target.
+	PLAN_FOLLOW,
+
+	PLAN_COUNT,
+};
+
+// Part of the AI state, saved with it.
+struct AiPlanState {
+	lair::uint8  type;
+	lair::uint8  step;
+	lair::uint32 start;  // turn when the plan started
+};
+
+struct AiPlanStep {
+	BtOp action;
+	int  actionArg;
+	BtOp wake;
+	int  wakeArg;
+	bool wakeIfFalse;
+};
+
+struct AiPlan {
+	const char*       name;
+	// The plan is dropped when abort holds. BT_OP_COUNT for never.
+	BtOp              abort;
+	int               abortArg;
+	const AiPlanStep* steps;
+	unsigned          stepCount;
+};
+
+extern const AiPlan aiPlans[PLAN_COUNT];
+
+// Returns the plan with the given name, or -1.
+int findAiPlan(const lair::String& name);
+
+// Plays a turn of the plan. Returns false if there is no plan, or if it is
+// over or dropped: then the behavior tree should play instead.
+template<typename Agent>
+bool resumePlan(AiPlanState& state, Agent& agent) {
+	if(state.type == PLAN_NONE || state.type >= PLAN_COUNT)
+		return false;
+
+	const AiPlan& plan = aiPlans[state.type];
+	if(plan.abort != BT_OP_COUNT && agent.leaf(plan.abort, plan.abortArg)) {
+		state.type = PLAN_NONE;
+		return false;
+	}
+
+	for(; state.step < plan.stepCount; ++state.step) {
+		const AiPlanStep& step = plan.steps[state.step];
+		if(agent.leaf(step.wake, step.wakeArg) == step.wakeIfFalse) {
+			agent.leaf(step.action, step.actionArg);
+			return true;
+		}
+	}
+
+	state.type = PLAN_NONE;
+	return false;
+}
+
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstdio>
+#include <cstring>
+
+#include <lair/core/log.h>
+
+#include "map_node.h"
+#include "character_class.h"
+#include "character.h"
+
+#include "async_log.h"
+
+
+using namespace lair;
+
+
+LogRecordWriter::LogRecordWriter(Byte* begin, Byte* end)
+    : _begin(begin)
+    , _it(begin)
+    , _end(end)
+    , _truncated(false)
+{
+}
+
+
+unsigned LogRecordWriter::size() const {
+	return _it - _begin;
+}
+
+
+bool LogRecordWriter::truncated() const {
+	return _truncated;
+}
+
+
+void LogRecordWriter::writeTag(Tag tag) {
+	// Always keep a byte for the END tag.
+	if(_it + 1 >= _end) {
+		_truncated = true;
+		return;
+	}
+	*(_it++) = tag;
+}
+
+
+void LogRecordWriter::writeUInt(uint64 value) {
+	while(value >= 0x80) {
+		if(_it + 1 >= _end) {
+			_truncated = true;
+			return;
+		}
+		*(_it++) = Byte(value | 0x80);
+		value >>= 7;
+	}
+	if(_it + 1 >= _end) {
+		_truncated = true;
+		return;
+	}
+	*(_it++) = Byte(value);
+}
+
+
+void LogRecordWriter::writeInt(int64 value) {
+	// Zig-zag encoding, so that small negative values stay small.
+	writeUInt((uint64(value) << 1) ^ uint64(value >> 63));
+}
+
+
+void LogRecordWriter::writeFloat(double value) {
+	if(_it + sizeof(double) >= _end) {
+		_truncated = true;
+		return;
+	}
+	std::memcpy(_it, &value, sizeof(double));
+	_it += sizeof(double);
+}
+
+
+void LogRecordWriter::writeChar(char c) {
+	if(_it + 1 >= _end) {
+		_truncated = true;
+		return;
+	}
+	*(_it++) = Byte(c);
+}
+
+
+void LogRecordWriter::writeString(const char* str, unsigned size) {
+	// Size is at most 2 bytes since slots are small.
+	unsigned avail = (_end - _it > 3)? _end - _it - 3: 0;
+	if(size > avail) {
+		size = avail;
+		_truncated = true;
+	}
+	writeUInt(size);
+	std::memcpy(_it, str, size);
+	_it += size;
+}
+
+
+
+void encodeLogArg(LogRecordWriter& w, bool value) {
+	w.writeTag(LogRecordWriter::UINT);
+	w.writeUInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, char value) {
+	w.writeTag(LogRecordWriter::CHAR);
+	w.writeChar(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, int value) {
+	w.writeTag(LogRecordWriter::INT);
+	w.writeInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, unsigned value) {
+	w.writeTag(LogRecordWriter::UINT);
+	w.writeUInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, long value) {
+	w.writeTag(LogRecordWriter::INT);
+	w.writeInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, unsigned long value) {
+	w.writeTag(LogRecordWriter::UINT);
+	w.writeUInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, long long value) {
+	w.writeTag(LogRecordWriter::INT);
+	w.writeInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, unsigned long long value) {
+	w.writeTag(LogRecordWriter::UINT);
+	w.writeUInt(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, double value) {
+	w.writeTag(LogRecordWriter::FLOAT);
+	w.writeFloat(value);
+}
+
+
+void encodeLogArg(LogRecordWriter& w, const char* value) {
+	w.writeTag(LogRecordWriter::STRING);
+	w.writeString(value, std::strlen(value));
+}
+
+
+void encodeLogArg(LogRecordWriter& w, const String& value) {
+	w.writeTag(LogRecordWriter::STRING);
+	w.writeString(value.data(), value.size());
+}
+
+
+void encodeLogArg(LogRecordWriter& w, const CharacterDebugName& value) {
+	// Store the parts of the name: the character might be gone by the time
+	// the record is formatted.
+	static const String nowhere = "<nowhere>";
+	const Character* c = value.character;
+	const String& nodeId = c->node()? c->node()->id(): nowhere;
+	w.writeTag(LogRecordWriter::DEBUG_NAME);
+	w.writeUInt(c->index());
+	w.writeString(c->className().data(), c->className().size());
+	w.writeString(nodeId.data(), nodeId.size());
+	w.writeUInt(c->place());
+}
+
+
+
+namespace {
+
+class LogRecordReader {
+public:
+	LogRecordReader(const Byte* begin, const Byte* end)
+	    : _it(begin)
+	    , _end(end)
+	{
+	}
+
+	bool atEnd() const {
+		return _it >= _end;
+	}
+
+	Byte readByte() {
+		return atEnd()? 0: *(_it++);
+	}
+
+	uint64 readUInt() {
+		uint64 value = 0;
+		unsigned shift = 0;
+		while(!atEnd()) {
+			Byte b = *(_it++);
+			value |= uint64(b & 0x7f) << shift;
+			if(!(b & 0x80))
+				break;
+			shift += 7;
+		}
+		return value;
+	}
+
+	int64 readInt() {
+		uint64 v = readUInt();
+		return int64(v >> 1) ^ -int64(v & 1);
+	}
+
+	double readFloat() {
+		double value = 0;
+		if(_it + sizeof(double) <= _end) {
+			std::memcpy(&value, _it, sizeof(double));
+			_it += sizeof(double);
+		}
+		return value;
+	}
+
+	void readString(String& out) {
+		unsigned size = readUInt();
+		size = std::min<unsigned>(size, _end - _it);
+		out.append((const char*)_it, size);
+		_it += size;
+	}
+
+private:
+	const Byte* _it;
+	const Byte* _end;
+};
+
+}
+
+
+AsyncLog::AsyncLog(std::ostream* out, MessageKind minLevel)
+    : _out(out)
+    , _minLevel(minLevel)
+    , _slots(new Slot[SLOT_COUNT])
+    , _enqueuePos(0)
+    , _dequeuePos(0)
+    , _overflowCount(0)
+    , _reportedOverflow(0)
+    , _running(false)
+    , _waiting(false)
+{
+	for(unsigned i = 0; i < SLOT_COUNT; ++i) {
+		_slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+
+AsyncLog::~AsyncLog() {
+	stop();
+}
+
+
+MessageKind AsyncLog::minLevel() const {
+	return _minLevel;
+}
+
+
+void AsyncLog::setMinLevel(MessageKind minLevel) {
+	_minLevel = minLevel;
+}
+
+
+MessageMask AsyncLog::wantedMessages() const {
+	MessageMask mask = 0;
+	for(unsigned kind = _minLevel; kind < MSG_CONSOLE; ++kind)
+		mask |= messageBit(MessageKind(kind));
+	return mask;
+}
+
+
+uint64 AsyncLog::overflowCount() const {
+	return _overflowCount.load(std::memory_order_relaxed);
+}
+
+
+void AsyncLog::start() {
+	if(_running)
+		return;
+
+	_running = true;
+	_thread = std::thread(&AsyncLog::_run, this);
+}
+
+
+void AsyncLog::stop() {
+	if(!_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_wakeUp.notify_one();
+	_thread.join();
+
+	// Write what remains.
+	while(_flush()) {}
+	_out->flush();
+}
+
+
+AsyncLog::Slot* AsyncLog::_acquire(uint64& pos) {
+	static_assert((SLOT_COUNT & (SLOT_COUNT - 1)) == 0,
+	              "SLOT_COUNT must be a power of 2");
+
+	pos = _enqueuePos.load(std::memory_order_relaxed);
+	for(;;) {
+		Slot& slot = _slots[pos & (SLOT_COUNT - 1)];
+		uint64 seq = slot.sequence.load(std::memory_order_acquire);
+		int64 diff = int64(seq) - int64(pos);
+		if(diff == 0) {
+			if(_enqueuePos.compare_exchange_weak(pos, pos + 1,
+			                                     std::memory_order_relaxed))
+				return &slot;
+		}
+		else if(diff < 0) {
+			// The consumer did not release this slot yet: the buffer is full.
+			return nullptr;
+		}
+		else {
+			pos = _enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+
+void AsyncLog::_commit(Slot* slot, uint64 pos) {
+	slot->sequence.store(pos + 1, std::memory_order_release);
+
+	// Pairs with the fence in _run(): either the consumer sees the record
+	// before it waits, or we see it waiting. Taking the lock makes sure it
+	// is actually waiting when notified.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if(_waiting.load(std::memory_order_relaxed)) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+		}
+		_wakeUp.notify_one();
+	}
+}
+
+
+bool AsyncLog::_hasRecord() const {
+	const Slot& slot = _slots[_dequeuePos & (SLOT_COUNT - 1)];
+	uint64 seq = slot.sequence.load(std::memory_order_acquire);
+	return int64(seq) - int64(_dequeuePos + 1) >= 0;
+}
+
+
+bool AsyncLog::_flush() {
+	bool wrote = false;
+	for(;;) {
+		if(!_hasRecord())
+			break;
+
+		Slot& slot = _slots[_dequeuePos & (SLOT_COUNT - 1)];
+		_format(slot);
+		slot.sequence.store(_dequeuePos + SLOT_COUNT, std::memory_order_release);
+		++_dequeuePos;
+		wrote = true;
+	}
+
+	uint64 overflow = overflowCount();
+	if(overflow != _reportedOverflow) {
+		*_out << "[warning] Log buffer full, " << overflow - _reportedOverflow
+		      << " records dropped.\n";
+		_reportedOverflow = overflow;
+		wrote = true;
+	}
+
+	if(wrote)
+		_out->flush();
+
+	return wrote;
+}
+
+
+void AsyncLog::_format(const Slot& slot) {
+	static const char* prefixes[] = {
+	    "[debug] ",
+	    "[info] ",
+	    "[log] ",
+	    "[warning] ",
+	    "[error] ",
+	};
+
+	_line.clear();
+	_line.append(prefixes[std::min<unsigned>(slot.kind, MSG_ERROR)]);
+
+	LogRecordReader r(slot.data, slot.data + slot.size);
+	while(!r.atEnd()) {
+		switch(r.readByte()) {
+		case LogRecordWriter::END:
+			break;
+		case LogRecordWriter::INT:
+			_line.append(std::to_string(r.readInt()));
+			break;
+		case LogRecordWriter::UINT:
+			_line.append(std::to_string(r.readUInt()));
+			break;
+		case LogRecordWriter::FLOAT: {
+			// Like the default of std::ostream, used by lair::cat().
+			char buffer[32];
+			int size = std::snprintf(buffer, sizeof(buffer), "%g", r.readFloat());
+			_line.append(buffer, std::min<unsigned>(std::max(size, 0), sizeof(buffer) - 1));
+			break;
+		}
+		case LogRecordWriter::CHAR:
+			_line.push_back(char(r.readByte()));
+			break;
+		case LogRecordWriter::STRING:
+			r.readString(_line);
+			break;
+		case LogRecordWriter::DEBUG_NAME:
+			_line.append(std::to_string(r.readUInt()));
+			_line.push_back(':');
+			r.readString(_line);
+			_line.append(" [");
+			r.readString(_line);
+			_line.push_back(':');
+			_line.append(placeName(Place(r.readUInt())));
+			_line.push_back(']');
+			break;
+		}
+	}
+
+	if(slot.truncated)
+		_line.append("...");
+	_line.push_back('\n');
+
+	_out->write(_line.data(), _line.size());
+}
+
+
+void AsyncLog::_run() {
+	while(_running.load()) {
+		if(_flush())
+			continue;
+
+		// Sleep until a record is committed or stop() is called.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_waiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		_wakeUp.wait(lock, [this] {
+			return _hasRecord() || !_running.load();
+		});
+		_waiting.store(false, std::memory_order_relaxed);
+	}
+}
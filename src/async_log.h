@@ -0,0 +1,191 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_ASYNC_LOG_H_
+#define LD41_ASYNC_LOG_H_
+
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <ostream>
+
+#include <lair/core/lair.h>
+
+#include "message_sink.h"
+
+
+struct CharacterName;
+struct CharacterDebugName;
+
+
+// Writes the arguments of a log record as tagged binary values in a fixed
+// size buffer. Records that do not fit are truncated.
+class LogRecordWriter {
+public:
+	enum Tag {
+		END,
+		INT,
+		UINT,
+		FLOAT,
+		CHAR,
+		STRING,
+		DEBUG_NAME,
+	};
+
+public:
+	LogRecordWriter(lair::Byte* begin, lair::Byte* end);
+
+	unsigned size() const;
+	bool truncated() const;
+
+	void writeTag(Tag tag);
+	void writeUInt(lair::uint64 value);
+	void writeInt(lair::int64 value);
+	void writeFloat(double value);
+	void writeChar(char c);
+	void writeString(const char* str, unsigned size);
+
+public:
+	lair::Byte* _begin;
+	lair::Byte* _it;
+	lair::Byte* _end;
+	bool        _truncated;
+};
+
+
+void encodeLogArg(LogRecordWriter& w, bool value);
+void encodeLogArg(LogRecordWriter& w, char value);
+void encodeLogArg(LogRecordWriter& w, int value);
+void encodeLogArg(LogRecordWriter& w, unsigned value);
+void encodeLogArg(LogRecordWriter& w, long value);
+void encodeLogArg(LogRecordWriter& w, unsigned long value);
+void encodeLogArg(LogRecordWriter& w, long long value);
+void encodeLogArg(LogRecordWriter& w, unsigned long long value);
+void encodeLogArg(LogRecordWriter& w, double value);
+void encodeLogArg(LogRecordWriter& w, const char* value);
+void encodeLogArg(LogRecordWriter& w, const lair::String& value);
+void encodeLogArg(LogRecordWriter& w, const CharacterDebugName& value);
+
+// Anything else is formatted right away.
+template<typename T>
+inline void encodeLogArg(LogRecordWriter& w, const T& value) {
+	encodeLogArg(w, lair::cat(value));
+}
+
+inline void encodeLogArgs(LogRecordWriter& /*w*/) {
+}
+
+template<typename T, typename... Args>
+inline void encodeLogArgs(LogRecordWriter& w, const T& arg, const Args&... args) {
+	encodeLogArg(w, arg);
+	encodeLogArgs(w, args...);
+}
+
+
+// Asynchronous log: records are encoded on the calling thread in a lock-free
+// multiple-producer / single-consumer ring buffer, then formatted and written
+// by a background thread. When the buffer is full, records are dropped and
+// counted.
+class AsyncLog {
+public:
+	enum {
+		SLOT_SIZE  = 240,
+		SLOT_COUNT = 4096,
+	};
+
+public:
+	AsyncLog(std::ostream* out, MessageKind minLevel = MSG_DEBUG);
+	AsyncLog(const AsyncLog&) = delete;
+	~AsyncLog();
+
+	AsyncLog& operator=(const AsyncLog&) = delete;
+
+	MessageKind minLevel() const;
+	void setMinLevel(MessageKind minLevel);
+
+	MessageMask wantedMessages() const;
+	inline bool wants(MessageKind kind) const {
+		return kind >= _minLevel && kind < MSG_CONSOLE;
+	}
+
+	lair::uint64 overflowCount() const;
+
+	void start();
+	void stop();
+
+	template<typename... Args>
+	inline void write(MessageKind kind, const Args&... args) {
+		lair::uint64 pos;
+		Slot* slot = _acquire(pos);
+		if(!slot) {
+			_overflowCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		LogRecordWriter w(slot->data, slot->data + SLOT_SIZE);
+		encodeLogArgs(w, args...);
+		slot->kind      = kind;
+		slot->size      = w.size();
+		slot->truncated = w.truncated();
+		_commit(slot, pos);
+	}
+
+private:
+	struct Slot {
+		std::atomic<lair::uint64> sequence;
+		lair::uint8               kind;
+		bool                      truncated;
+		lair::uint16              size;
+		lair::Byte                data[SLOT_SIZE];
+	};
+
+private:
+	Slot* _acquire(lair::uint64& pos);
+	void _commit(Slot* slot, lair::uint64 pos);
+
+	bool _hasRecord() const;
+	bool _flush();
+	void _format(const Slot& slot);
+	void _run();
+
+private:
+	std::ostream*             _out;
+	MessageKind               _minLevel;
+
+	std::unique_ptr<Slot[]>   _slots;
+	std::atomic<lair::uint64> _enqueuePos;
+	lair::uint64              _dequeuePos;
+	std::atomic<lair::uint64> _overflowCount;
+	lair::uint64              _reportedOverflow;
+
+	std::thread               _thread;
+	std::atomic<bool>         _running;
+	std::atomic<bool>         _waiting;
+	std::mutex                _mutex;
+	std::condition_variable   _wakeUp;
+
+	lair::String              _line;
+};
+
+
+#endif
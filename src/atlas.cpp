@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/log.h>
+#include <lair/core/parse.h>
+
+#include "atlas.h"
+
+
+using namespace lair;
+
+
+Atlas::Atlas() {
+}
+
+
+bool Atlas::read(std::istream& in, const Path& path) {
+	ErrorList errors;
+	LdlParser parser(&in, path.utf8String(), &errors, LdlParser::CTX_MAP);
+
+	Variant config;
+	bool ok = ldlRead(parser, config);
+	errors.log(dbgLogger);
+	if(!ok || !config.isVarMap()) {
+		dbgLogger.error("Failed to load atlas \"", path.utf8String(), "\"");
+		return false;
+	}
+
+	const Variant& texture = config.get("texture");
+	const Variant& size    = config.get("size");
+	const Variant& images  = config.get("images");
+	if(!texture.isString() || !size.isVarList() || size.asVarList().size() != 2
+	|| !images.isVarList()) {
+		dbgLogger.error("Invalid atlas \"", path.utf8String(), "\"");
+		return false;
+	}
+
+	Vector2 texSize(size.asVarList()[0].asInt(), size.asVarList()[1].asInt());
+	unsigned index = _textures.size();
+	_textures.push_back(texture.asString());
+
+	for(const Variant& image: images.asVarList()) {
+		const VarList* fields = image.isVarList()? &image.asVarList(): nullptr;
+		if(!fields || fields->size() != 5 || !(*fields)[0].isString()) {
+			dbgLogger.warning("Invalid image in atlas \"", path.utf8String(), "\"");
+			continue;
+		}
+
+		// Rectangles are in pixels from the top-left corner, views in
+		// texture coordinates from the bottom-left.
+		Vector2 pos ((*fields)[1].asInt(), (*fields)[2].asInt());
+		Vector2 rect((*fields)[3].asInt(), (*fields)[4].asInt());
+		Vector2 min(pos(0), texSize(1) - pos(1) - rect(1));
+		Vector2 max = min + rect;
+		_regions[(*fields)[0].asString()] = Region{
+		    index,
+		    Box2(min.cwiseQuotient(texSize), max.cwiseQuotient(texSize))
+		};
+	}
+
+	return true;
+}
+
+
+void Atlas::clear() {
+	_textures.clear();
+	_regions.clear();
+}
+
+
+const String& Atlas::texture(const String& image) const {
+	auto it = _regions.find(image);
+	if(it == _regions.end())
+		return image;
+	return _textures[it->second.texture];
+}
+
+
+void Atlas::setImage(SpriteComponent* sprite, const String& image) const {
+	auto it = _regions.find(image);
+	if(it == _regions.end()) {
+		sprite->setTexture(image);
+		sprite->setView(Box2(Vector2(0, 0), Vector2(1, 1)));
+		return;
+	}
+
+	sprite->setTexture(_textures[it->second.texture]);
+	sprite->setView(it->second.view);
+}
@@ -0,0 +1,66 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_ATLAS_H_
+#define LD41_ATLAS_H_
+
+
+#include <istream>
+#include <unordered_map>
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/path.h>
+
+#include <lair/ec/sprite_component.h>
+
+
+// Images packed into a few textures by tools/pack_atlas.py. Sprites that
+// use images of the same atlas share its texture, so the renderer can draw
+// them in a single batch. Images that are not packed are used as is.
+class Atlas {
+public:
+	Atlas();
+
+	// Adds the images of the atlas described by the ldl file in.
+	bool read(std::istream& in, const lair::Path& path);
+	void clear();
+
+	// The texture to load to get image.
+	const lair::String& texture(const lair::String& image) const;
+
+	// Shows image on sprite, using the region of its atlas if it is packed.
+	void setImage(lair::SpriteComponent* sprite, const lair::String& image) const;
+
+private:
+	struct Region {
+		unsigned   texture;
+		lair::Box2 view;
+	};
+	typedef std::unordered_map<lair::String, Region> RegionMap;
+
+private:
+	std::vector<lair::String> _textures;
+	RegionMap                 _regions;
+};
+
+
+#endif
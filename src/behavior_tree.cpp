@@ -0,0 +1,251 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstring>
+
+#include <lair/core/log.h>
+
+#include "ai_plan.h"
+
+#include "behavior_tree.h"
+
+
+using namespace lair;
+
+
+namespace {
+
+enum BtArg {
+	ARG_NONE,
+	ARG_COUNT,     // optional, 1 by default
+	ARG_INT,
+	ARG_PLACE,
+	ARG_STATUS,
+	ARG_DIR,
+	ARG_STRING,
+	ARG_PLAN,
+	ARG_CHILD,
+	ARG_CHILDREN,
+};
+
+struct BtOpInfo {
+	const char* name;
+	BtArg       arg;
+};
+
+// Indexed by BtOp.
+const BtOpInfo btOps[BT_OP_COUNT] = {
+    { "selector",         ARG_CHILDREN },
+    { "sequence",         ARG_CHILDREN },
+    { "not",              ARG_CHILD },
+    { "always",           ARG_CHILD },
+
+    { "hp_below",         ARG_INT },
+    { "rested",           ARG_NONE },
+    { "enemies",          ARG_COUNT },
+    { "allied_redshirts", ARG_COUNT },
+    { "allied_towers",    ARG_COUNT },
+    { "range_is",         ARG_INT },
+    { "in_row",           ARG_PLACE },
+    { "status",           ARG_STATUS },
+    { "at_fonxus",        ARG_NONE },
+    { "off_lane",         ARG_NONE },
+    { "on_lane",          ARG_NONE },
+    { "plan_elapsed",     ARG_INT },
+
+    { "set_status",       ARG_STATUS },
+    { "attack_closest",   ARG_NONE },
+    { "move",             ARG_DIR },
+    { "go_to_fonxus",     ARG_NONE },
+    { "join_lane",        ARG_NONE },
+    { "set_row",          ARG_PLACE },
+    { "use_skill",        ARG_STRING },
+    { "follow_player",    ARG_NONE },
+    { "start_plan",       ARG_PLAN },
+};
+
+// Indexed by BtTree.
+const char* btTreeNames[BT_TREE_COUNT] = {
+    "hero_status",
+    "hero",
+    "redshirt",
+    "tower",
+};
+
+// Same order as Place, HeroAi::Status and HeroAi::Dir.
+const char* placeNames[]  = { "back", "front", nullptr };
+const char* statusNames[] = { "push_lane", "follow_player", "back_to_base", nullptr };
+const char* dirNames[]    = { "forward", "back", nullptr };
+
+int findName(const char** names, const String& name) {
+	for(int i = 0; names[i]; ++i) {
+		if(name == names[i])
+			return i;
+	}
+	return -1;
+}
+
+}
+
+
+BehaviorTrees::BehaviorTrees() {
+	for(unsigned& root: _roots)
+		root = NO_TREE;
+}
+
+
+bool BehaviorTrees::compile(const Variant& config) {
+	if(!config.isVarMap()) {
+		dbgLogger.error("Expected \"ai\" VarMap.");
+		return false;
+	}
+
+	std::vector<BtNode> nodes;
+	std::vector<String> strings;
+	unsigned roots[BT_TREE_COUNT];
+	bool ok = true;
+
+	for(unsigned tree = 0; tree < BT_TREE_COUNT; ++tree) {
+		const Variant& var = config.get(btTreeNames[tree]);
+		if(var.isNull()) {
+			dbgLogger.warning("No behavior tree for \"", btTreeNames[tree], "\".");
+			roots[tree] = NO_TREE;
+			continue;
+		}
+		roots[tree] = nodes.size();
+		ok = _compile(var, btTreeNames[tree], nodes, strings) && ok;
+	}
+
+	for(const auto& pair: config.asVarMap()) {
+		bool known = false;
+		for(const char* name: btTreeNames)
+			known = known || pair.first == name;
+		if(!known)
+			dbgLogger.warning("Unknown behavior tree \"", pair.first, "\".");
+	}
+
+	if(!ok)
+		return false;
+
+	_nodes   = std::move(nodes);
+	_strings = std::move(strings);
+	std::memcpy(_roots, roots, sizeof(_roots));
+	return true;
+}
+
+
+bool BehaviorTrees::hasTree(BtTree tree) const {
+	return _roots[tree] != NO_TREE;
+}
+
+
+bool BehaviorTrees::_compile(const Variant& var, const String& tree,
+                             std::vector<BtNode>& nodes, std::vector<String>& strings) const {
+	if(!var.isVarList() || var.asVarList().empty() || !var.asVarList()[0].isString()) {
+		dbgLogger.error("Behavior tree \"", tree, "\": expected a list starting with a node name.");
+		return false;
+	}
+
+	const VarList& list = var.asVarList();
+	const String& name = list[0].asString();
+
+	unsigned op = 0;
+	while(op < BT_OP_COUNT && name != btOps[op].name)
+		++op;
+	if(op == BT_OP_COUNT) {
+		dbgLogger.error("Behavior tree \"", tree, "\": unknown node \"", name, "\".");
+		return false;
+	}
+
+	if(nodes.size() >= MAX_NODES) {
+		dbgLogger.error("Behavior tree \"", tree, "\": too many nodes.");
+		return false;
+	}
+
+	unsigned index = nodes.size();
+	nodes.push_back(BtNode{ uint8(op), 0, 0, 0 });
+
+	BtArg argType = btOps[op].arg;
+	unsigned argCount = list.size() - 1;
+	bool ok = true;
+	int arg = 0;
+	switch(argType) {
+	case ARG_NONE:
+		ok = argCount == 0;
+		break;
+	case ARG_COUNT:
+		arg = 1;
+		if(argCount == 1 && list[1].isInt())
+			arg = list[1].asInt();
+		else
+			ok = argCount == 0;
+		break;
+	case ARG_INT:
+		ok = argCount == 1 && list[1].isInt();
+		if(ok)
+			arg = list[1].asInt();
+		break;
+	case ARG_PLACE:
+	case ARG_STATUS:
+	case ARG_DIR: {
+		const char** names = (argType == ARG_PLACE)?  placeNames:
+		                     (argType == ARG_STATUS)? statusNames: dirNames;
+		ok = argCount == 1 && list[1].isString();
+		if(ok) {
+			arg = findName(names, list[1].asString());
+			ok = arg >= 0;
+		}
+		break;
+	}
+	case ARG_STRING:
+		ok = argCount == 1 && list[1].isString();
+		if(ok) {
+			arg = strings.size();
+			strings.push_back(list[1].asString());
+		}
+		break;
+	case ARG_PLAN:
+		ok = argCount == 1 && list[1].isString();
+		if(ok) {
+			arg = findAiPlan(list[1].asString());
+			ok = arg >= 0;
+		}
+		break;
+	case ARG_CHILD:
+	case ARG_CHILDREN:
+		ok = (argType == ARG_CHILD)? argCount == 1: argCount >= 1;
+		for(unsigned i = 1; ok && i < list.size(); ++i) {
+			// The child already reported its error.
+			if(!_compile(list[i], tree, nodes, strings))
+				return false;
+		}
+		break;
+	}
+
+	if(!ok) {
+		dbgLogger.error("Behavior tree \"", tree, "\": invalid arguments for \"", name, "\".");
+		return false;
+	}
+
+	nodes[index].arg = arg;
+	nodes[index].end = nodes.size();
+	return true;
+}
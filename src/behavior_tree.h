@@ -0,0 +1,157 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_BEHAVIOR_TREE_H_
+#define LD41_BEHAVIOR_TREE_H_
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+#include <lair/core/parse.h>
+
+
+// Behavior trees of the AIs, defined in the "ai" section of gameplay.ldl.
+// A node is a list whose first item is the node name:
+//
+//   [ "selector", child... ]  Runs the children until one succeeds.
+//   [ "sequence", child... ]  Runs the children until one fails.
+//   [ "not", child ]          Inverts the child result.
+//   [ "always", child ]       Runs the child and succeeds.
+//
+// The other nodes are conditions and actions, listed in behavior_tree.cpp.
+//
+// Trees are compiled to a single array of nodes in depth-first order, each
+// node knowing where its subtree ends, so that running a tree is a walk on
+// the array without allocation. TextMoba runs them on its characters and
+// SimModel on its states: both provide the leaves.
+
+enum BtOp {
+	// Composites
+	BT_SELECTOR,
+	BT_SEQUENCE,
+	BT_NOT,
+	BT_ALWAYS,
+
+	// Conditions
+	BT_HP_BELOW,          // arg: percent of max hp
+	BT_RESTED,            // full hp and mana
+	BT_ENEMIES,           // arg: min count
+	BT_ALLIED_REDSHIRTS,  // arg: min count
+	BT_ALLIED_TOWERS,     // arg: min count, fonxus included
+	BT_RANGE_IS,          // arg: range
+	BT_IN_ROW,            // arg: Place
+	BT_STATUS,            // arg: HeroAi::Status
+	BT_AT_FONXUS,
+	BT_OFF_LANE,
+	BT_ON_LANE,
+	BT_PLAN_ELAPSED,      // arg: turns since the plan started
+
+	// Actions, that fail if there is nothing to do.
+	BT_SET_STATUS,        // arg: HeroAi::Status
+	BT_ATTACK_CLOSEST,
+	BT_MOVE,              // arg: HeroAi::Dir
+	BT_GO_TO_FONXUS,
+	BT_JOIN_LANE,
+	BT_SET_ROW,           // arg: Place
+	BT_USE_SKILL,         // arg: skill id, in BehaviorTrees::_strings
+	BT_FOLLOW_PLAYER,     // join the player, then attack their target
+	BT_START_PLAN,        // arg: AiPlanType, see ai_plan.h
+
+	BT_OP_COUNT,
+};
+
+enum BtTree {
+	BT_HERO_STATUS,
+	BT_HERO,
+	BT_REDSHIRT,
+	BT_TOWER,
+
+	BT_TREE_COUNT,
+};
+
+struct BtNode {
+	lair::uint8  op;
+	lair::uint8  pad;
+	lair::uint16 end;
+	lair::int32  arg;
+};
+
+
+class BehaviorTrees {
+public:
+	enum {
+		NO_TREE   = 0xffff,
+		MAX_NODES = 0xffff,
+	};
+
+public:
+	BehaviorTrees();
+
+	// Compiles the "ai" section of gameplay.ldl. On error, logs it and
+	// leaves the trees unchanged.
+	bool compile(const lair::Variant& config);
+
+	bool hasTree(BtTree tree) const;
+
+	// Returns the result of the root node, false if there is no tree.
+	template<typename Agent>
+	bool run(BtTree tree, Agent& agent) const {
+		return _roots[tree] != NO_TREE && _run(_roots[tree], agent);
+	}
+
+	template<typename Agent>
+	bool _run(unsigned index, Agent& agent) const {
+		const BtNode& node = _nodes[index];
+		switch(node.op) {
+		case BT_SELECTOR:
+			for(unsigned i = index + 1; i < node.end; i = _nodes[i].end) {
+				if(_run(i, agent))
+					return true;
+			}
+			return false;
+		case BT_SEQUENCE:
+			for(unsigned i = index + 1; i < node.end; i = _nodes[i].end) {
+				if(!_run(i, agent))
+					return false;
+			}
+			return true;
+		case BT_NOT:
+			return !_run(index + 1, agent);
+		case BT_ALWAYS:
+			_run(index + 1, agent);
+			return true;
+		default:
+			return agent.leaf(BtOp(node.op), node.arg);
+		}
+	}
+
+	bool _compile(const lair::Variant& var, const lair::String& tree,
+	              std::vector<BtNode>& nodes, std::vector<lair::String>& strings) const;
+
+public:
+	std::vector<BtNode>       _nodes;
+	unsigned                  _roots[BT_TREE_COUNT];
+	std::vector<lair::String> _strings;
+};
+
+
+#endif
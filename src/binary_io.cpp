@@ -0,0 +1,150 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "binary_io.h"
+
+
+using namespace lair;
+
+
+BinaryWriter::BinaryWriter(std::ostream* out)
+    : _out(out)
+{
+}
+
+
+bool BinaryWriter::good() const {
+	return _out->good();
+}
+
+
+void BinaryWriter::writeByte(Byte byte) {
+	_out->put(char(byte));
+}
+
+
+void BinaryWriter::writeBytes(const void* data, unsigned size) {
+	_out->write((const char*)data, size);
+}
+
+
+void BinaryWriter::writeUInt(uint64 value) {
+	while(value >= 0x80) {
+		writeByte(Byte(value | 0x80));
+		value >>= 7;
+	}
+	writeByte(Byte(value));
+}
+
+
+void BinaryWriter::writeInt(int64 value) {
+	writeUInt((uint64(value) << 1) ^ uint64(value >> 63));
+}
+
+
+void BinaryWriter::writeBool(bool value) {
+	writeByte(value? 1: 0);
+}
+
+
+void BinaryWriter::writeString(const String& str) {
+	writeUInt(str.size());
+	writeBytes(str.data(), str.size());
+}
+
+
+
+BinaryReader::BinaryReader(std::istream* in)
+    : _in(in)
+    , _good(in->good())
+{
+}
+
+
+bool BinaryReader::good() const {
+	return _good;
+}
+
+
+bool BinaryReader::atEnd() {
+	return !_good || _in->peek() == std::istream::traits_type::eof();
+}
+
+
+void BinaryReader::fail() {
+	_good = false;
+}
+
+
+Byte BinaryReader::readByte() {
+	int c = _in->get();
+	if(c == std::istream::traits_type::eof()) {
+		_good = false;
+		return 0;
+	}
+	return Byte(c);
+}
+
+
+bool BinaryReader::readBytes(void* data, unsigned size) {
+	_in->read((char*)data, size);
+	if(unsigned(_in->gcount()) != size)
+		_good = false;
+	return _good;
+}
+
+
+uint64 BinaryReader::readUInt() {
+	uint64 value = 0;
+	for(unsigned shift = 0; shift < 64 && _good; shift += 7) {
+		Byte b = readByte();
+		value |= uint64(b & 0x7f) << shift;
+		if(!(b & 0x80))
+			return value;
+	}
+	_good = false;
+	return 0;
+}
+
+
+int64 BinaryReader::readInt() {
+	uint64 v = readUInt();
+	return int64(v >> 1) ^ -int64(v & 1);
+}
+
+
+bool BinaryReader::readBool() {
+	return readByte() != 0;
+}
+
+
+String BinaryReader::readString() {
+	uint64 size = readUInt();
+	// Protect against garbage: nothing we write is that big.
+	if(!_good || size > (1u << 24)) {
+		_good = false;
+		return String();
+	}
+
+	String str(size, '\0');
+	readBytes(&str[0], size);
+	return str;
+}
@@ -0,0 +1,74 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_BINARY_IO_H_
+#define LD41_BINARY_IO_H_
+
+
+#include <istream>
+#include <ostream>
+
+#include <lair/core/lair.h>
+
+
+// Compact binary streams: integers are stored as LEB128 varints (zig-zag
+// encoded when signed) and strings are prefixed by their size.
+class BinaryWriter {
+public:
+	BinaryWriter(std::ostream* out);
+
+	bool good() const;
+
+	void writeByte(lair::Byte byte);
+	void writeBytes(const void* data, unsigned size);
+	void writeUInt(lair::uint64 value);
+	void writeInt(lair::int64 value);
+	void writeBool(bool value);
+	void writeString(const lair::String& str);
+
+public:
+	std::ostream* _out;
+};
+
+
+class BinaryReader {
+public:
+	BinaryReader(std::istream* in);
+
+	// False if a read failed: the stream ended or the data is invalid.
+	bool good() const;
+	bool atEnd();
+	void fail();
+
+	lair::Byte readByte();
+	bool readBytes(void* data, unsigned size);
+	lair::uint64 readUInt();
+	lair::int64 readInt();
+	bool readBool();
+	lair::String readString();
+
+public:
+	std::istream* _in;
+	bool          _good;
+};
+
+
+#endif
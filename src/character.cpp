@@ -24,6 +24,9 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "skill.h"
+#include "state_hash.h"
+#include "binary_io.h"
+#include "lane_stats.h"
 
 #include "character.h"
 
@@ -43,6 +46,8 @@ Character::Character(TextMoba* textMoba, CharacterClassSP cClass, unsigned index
     , _hp(cClass->maxHP(level))
     , _mana(cClass->maxMana(level))
     , _deathTime(0)
+    , _hashed(false)
+    , _aggregated(false)
 {
 }
 
@@ -73,6 +78,23 @@ String Character::name(bool showIndex) const {
 	}
 
 	std::ostringstream out;
+	writeName(out, showIndex);
+	return out.str();
+}
+
+
+String Character::debugName() const {
+	std::ostringstream out;
+	writeDebugName(out);
+	return out.str();
+}
+
+
+void Character::writeName(std::ostream& out, bool showIndex) const {
+	if(isPlayer()) {
+		out << "you";
+		return;
+	}
 
 	if(type() != REDSHIRT)
 		out << teamName() << " ";
@@ -81,14 +103,12 @@ String Character::name(bool showIndex) const {
 
 	if(showIndex && _node)
 		out << " " << _node->characterIndex(shared_from_this());
-
-	return out.str();
 }
 
 
-String Character::debugName() const {
-	return cat(index(), ":", className(),
-	           " [", node()? node()->id(): "<nowhere>", ":", placeName(), "]");
+void Character::writeDebugName(std::ostream& out) const {
+	out << index() << ":" << className()
+	    << " [" << (node()? node()->id(): "<nowhere>") << ":" << placeName() << "]";
 }
 
 
@@ -201,7 +221,10 @@ SkillSP Character::skill(const String& name) {
 
 void Character::addSkill(SkillModelSP model, unsigned level) {
 	SkillSP skill = std::make_shared<Skill>(model, level, shared_from_this());
+	skill->_slot = _skills.size();
 	_skills.emplace_back(skill);
+	if(_hashed)
+		_textMoba->_characterHash ^= skill->computeHash();
 }
 
 
@@ -215,6 +238,116 @@ unsigned Character::placeIndex() const {
 }
 
 
+void Character::setNode(MapNodeSP node) {
+	_rehash(HASH_NODE, _node? hashString(_node->id()): 0,
+	                   node?  hashString(node->id()):  0);
+	if(_hashed)
+		_textMoba->_laneStats->_update(*this, -1);
+	_node = node;
+	if(_hashed)
+		_textMoba->_laneStats->_update(*this, 1);
+}
+
+
+void Character::setPlace(Place place) {
+	_rehash(HASH_PLACE, _place, place);
+	_place = place;
+}
+
+
+void Character::setLevel(unsigned level) {
+	_rehash(HASH_LEVEL, _level, level);
+	_level = level;
+}
+
+
+void Character::setXp(unsigned xp) {
+	_rehash(HASH_XP, _xp, xp);
+	_xp = xp;
+}
+
+
+void Character::setHp(unsigned hp) {
+	_rehash(HASH_HP, _hp, hp);
+	if(_hashed)
+		_textMoba->_laneStats->_updateHp(*this, int(hp) - int(_hp));
+	_hp = hp;
+}
+
+
+void Character::setMana(unsigned mana) {
+	_rehash(HASH_MANA, _mana, mana);
+	_mana = mana;
+}
+
+
+void Character::setDeathTime(unsigned deathTime) {
+	_rehash(HASH_DEATH_TIME, _deathTime, deathTime);
+	_deathTime = deathTime;
+}
+
+
+void Character::addBuff(const Buff& buff) {
+	if(_hashed)
+		_textMoba->_characterHash ^= _buffKey(_buffs.size(), buff);
+	_buffs.push_back(buff);
+}
+
+
+void Character::setBuffs(BuffVector&& buffs) {
+	if(_hashed) {
+		for(unsigned i = 0; i < _buffs.size(); ++i)
+			_textMoba->_characterHash ^= _buffKey(i, _buffs[i]);
+		for(unsigned i = 0; i < buffs.size(); ++i)
+			_textMoba->_characterHash ^= _buffKey(i, buffs[i]);
+	}
+	_buffs = std::move(buffs);
+}
+
+
+uint64 Character::computeHash() const {
+	uint64 hash = _hashKey(HASH_CLASS, hashString(className()) + _team)
+	            ^ _hashKey(HASH_NODE, _node? hashString(_node->id()): 0)
+	            ^ _hashKey(HASH_PLACE, _place)
+	            ^ _hashKey(HASH_LEVEL, _level)
+	            ^ _hashKey(HASH_XP, _xp)
+	            ^ _hashKey(HASH_HP, _hp)
+	            ^ _hashKey(HASH_MANA, _mana)
+	            ^ _hashKey(HASH_DEATH_TIME, _deathTime);
+	for(unsigned i = 0; i < _buffs.size(); ++i)
+		hash ^= _buffKey(i, _buffs[i]);
+	for(const SkillSP& skill: _skills)
+		hash ^= skill->computeHash();
+	return hash;
+}
+
+
+uint64 Character::_hashKey(unsigned field, uint64 value) const {
+	return zobristKey(_index, field, value);
+}
+
+
+uint64 Character::_buffKey(unsigned slot, const Buff& buff) const {
+	return _hashKey(HASH_BUFF, uint64(slot) << 48 ^ uint64(buff.ticks) << 40
+	                         ^ uint64(Byte(buff.type)) << 32 ^ uint32(buff.amount));
+}
+
+
+void Character::_rehash(unsigned field, uint64 oldValue, uint64 newValue) {
+	if(_hashed)
+		_textMoba->_characterHash ^= _hashKey(field, oldValue) ^ _hashKey(field, newValue);
+}
+
+
+void Character::_setHashed(bool hashed) {
+	if(hashed != _hashed) {
+		_textMoba->_characterHash ^= computeHash();
+		_textMoba->_laneStats->_update(*this, hashed? 1: -1);
+		_hashed = hashed;
+	}
+}
+
+
 void Character::moveTo(MapNodeSP dest) {
 	_textMoba->moveCharacter(shared_from_this(), dest);
 }
@@ -238,3 +371,32 @@ void Character::takeDamage(unsigned damage, CharacterSP attacker) {
 void Character::heal(unsigned amount, CharacterSP healer) {
 	_textMoba->healCharacter(shared_from_this(), amount, healer);
 }
+
+
+std::ostream& operator<<(std::ostream& out, const CharacterName& name) {
+	name.character->writeName(out, name.showIndex);
+	return out;
+}
+
+
+std::ostream& operator<<(std::ostream& out, const CharacterDebugName& name) {
+	name.character->writeDebugName(out);
+	return out;
+}
+
+
+void writeCharacterRef(BinaryWriter& writer, CharacterSP character) {
+	writer.writeUInt(character? character->index() + 1: 0);
+}
+
+
+CharacterSP readCharacterRef(BinaryReader& reader, const CharacterIndexMap& characters) {
+	uint64 ref = reader.readUInt();
+	if(ref == 0)
+		return nullptr;
+
+	auto it = characters.find(ref - 1);
+	if(it == characters.end())
+		return nullptr;
+	return it->second;
+}
@@ -50,6 +50,8 @@ public:
 
 	lair::String name(bool showIndex = true) const;
 	lair::String debugName() const;
+	void writeName(std::ostream& out, bool showIndex = true) const;
+	void writeDebugName(std::ostream& out) const;
 	lair::String shortDesc() const;
 
 	MapNodeSP node() const;
@@ -90,6 +92,24 @@ public:
 
 	unsigned placeIndex() const;
 
+	// Setters keep the state hash of TextMoba up to date: game logic must
+	// not write the fields directly.
+	void setNode(MapNodeSP node);
+	void setPlace(Place place);
+	void setLevel(unsigned level);
+	void setXp(unsigned xp);
+	void setHp(unsigned hp);
+	void setMana(unsigned mana);
+	void setDeathTime(unsigned deathTime);
+	void addBuff(const Buff& buff);
+	void setBuffs(BuffVector&& buffs);
+
+	lair::uint64 computeHash() const;
+	lair::uint64 _hashKey(unsigned field, lair::uint64 value) const;
+	lair::uint64 _buffKey(unsigned slot, const Buff& buff) const;
+	void _rehash(unsigned field, lair::uint64 oldValue, lair::uint64 newValue);
+	void _setHashed(bool hashed);
+
 	void moveTo(MapNodeSP dest);
 	void goToPlace(Place place);
 	void attack(CharacterSP target);
@@ -119,7 +139,41 @@ public:
 	SkillVector _skills;
 
 	AiSP     _ai;
+
+	// True if this character is part of the state hash.
+	bool     _hashed;
+	// Set when this turn was already played, see
+	// TextMoba::_resolveQuietFights().
+	bool     _aggregated;
+};
+
+
+// Lazy versions of Character::name() and Character::debugName(): the name
+// is only built when the message is actually formatted.
+struct CharacterName {
+	const Character* character;
+	bool             showIndex;
+};
+
+struct CharacterDebugName {
+	const Character* character;
 };
 
+inline CharacterName nameOf(const CharacterSP& character, bool showIndex = true) {
+	return CharacterName{ character.get(), showIndex };
+}
+
+inline CharacterDebugName debugNameOf(const CharacterSP& character) {
+	return CharacterDebugName{ character.get() };
+}
+
+std::ostream& operator<<(std::ostream& out, const CharacterName& name);
+std::ostream& operator<<(std::ostream& out, const CharacterDebugName& name);
+
+
+// Characters are saved as their index + 1, 0 being a null character.
+void writeCharacterRef(BinaryWriter& writer, CharacterSP character);
+CharacterSP readCharacterRef(BinaryReader& reader, const CharacterIndexMap& characters);
+
 
 #endif
@@ -20,6 +20,7 @@
 
 
 #include <functional>
+#include <fstream>
 
 #include <lair/core/log.h>
 #include <lair/core/text.h>
@@ -29,6 +30,8 @@
 #include "character.h"
 #include "skill.h"
 #include "text_moba.h"
+#include "speculator.h"
+#include "lane_stats.h"
 
 #include "commands.h"
 
@@ -140,6 +143,11 @@ bool LookCommand::exec(const StringVector& args) {
 		return true;
 	}
 
+	// Looking around is automatic at the end of each turn, don't build the
+	// description if nobody reads it.
+	if(!tm()->wants(MSG_CONSOLE))
+		return true;
+
 	if(args.size() == 1) {
 		MapNodeSP node = player()->node();
 		print("You are at ", node->name(), ".");
@@ -149,7 +157,7 @@ bool LookCommand::exec(const StringVector& args) {
 		CharacterGroups groups = node->characterGroups();
 		for(CharacterSP c: node->characters()) {
 			print("  ", i, ": ",
-			      "[", c->placeName(), "] ", c->name(false), " (lvl ",
+			      "[", c->placeName(), "] ", nameOf(c, false), " (lvl ",
 			      c->level() + 1, ", ", c->hp(), " / ", c->maxHP(), ")",
 			      " dist: ", groups.distanceBetween(player(), c)
 			);
@@ -187,6 +195,33 @@ bool DirectionsCommand::exec(const StringVector& /*args*/) {
 
 
 
+LanesCommand::LanesCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("lanes");
+
+	_desc = "  Show the forces on each lane and how far each team pushed.";
+}
+
+bool LanesCommand::exec(const StringVector& /*args*/) {
+	const LaneStats& stats = tm()->laneStats();
+	for(Lane lane: { TOP, BOT }) {
+		print(laneName(lane), " lane:");
+		for(Team team: { BLUE, RED }) {
+			const LaneStats::TeamStats& ts = stats.lane(lane, team);
+			MapNode* front = stats.frontNode(lane, team);
+			print("  ", teamName(team), ": ", ts.redshirts, " shirts (", ts.redshirtHp,
+			      " hp), ", ts.heroes, " heroes (", ts.heroHp, " hp), ",
+			      ts.towers, " towers. Front: ", front? front->name(): "none", ".");
+		}
+	}
+	print("Your team is needed the most on the ",
+	      laneName(stats.neediestLane(player()->team())), " lane.");
+	return true;
+}
+
+
+
 WaitCommand::WaitCommand(TextMoba* textMoba)
     : TMCommand(textMoba)
 {
@@ -242,6 +277,56 @@ bool GoCommand::exec(const StringVector& args) {
 
 
 
+GotoCommand::GotoCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("goto");
+
+	_desc = "  Walk to a place by the shortest path, one step per turn. Stops\n"
+	        "  when enemies are around. Example: goto red fonxus";
+}
+
+bool GotoCommand::exec(const StringVector& args) {
+	if(!player()->isAlive()) {
+		print("You are dead... Please use the command \"wait\" until you respawn.");
+		return true;
+	}
+
+	if(args.size() < 2) {
+		print("I don't understand where you want to go. Type");
+		print("  ", args[0], " <place>");
+		return true;
+	}
+
+	String name = join(args.begin() + 1, args.end(), " ");
+	MapNodeSP dest = tm()->findNode(name);
+	if(!dest) {
+		print("Unknown place \"", name, "\"");
+		return true;
+	}
+
+	while(tm()->isRunning() && player()->isAlive() && player()->node() != dest) {
+		MapNodeSP hop = tm()->nextHop(player()->team(), player()->node(), dest);
+		if(!hop) {
+			print("You can't find a way to ", dest->name(), ".");
+			break;
+		}
+
+		tm()->moveCharacter(player(), hop);
+		tm()->nextTurn();
+
+		if(player()->node() &&
+		        player()->node()->characterGroups().count(player()->enemyTeam())) {
+			print("You stop, there are enemies around.");
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+
 MoveCommand::MoveCommand(TextMoba* textMoba)
     : TMCommand(textMoba)
 {
@@ -425,7 +510,7 @@ bool UseCommand::exec(const StringVector& args) {
 			return true;
 		}
 
-		player()->_mana -= skill->manaCost();
+		player()->setMana(player()->mana() - skill->manaCost());
 		skill->useOn(targets);
 		tm()->nextTurn();
 	}
@@ -435,6 +520,90 @@ bool UseCommand::exec(const StringVector& args) {
 
 
 
+CallCommand::CallCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("call");
+
+	_desc = "  Call the allied heroes. They come to you and attack what you\n"
+	        "  attack for a few turns, unless they need to heal.";
+}
+
+bool CallCommand::exec(const StringVector& /*args*/) {
+	if(!player()->isAlive()) {
+		print("You are dead... Please use the command \"wait\" until you respawn.");
+		return true;
+	}
+
+	if(tm()->callHeroes(player()))
+		print("You call your allies to your side.");
+	else
+		print("You call your allies, but nobody answers.");
+
+	_textMoba->nextTurn();
+	return true;
+}
+
+
+
+SaveCommand::SaveCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("save");
+
+	_desc = "  Save the game in a file. Example: save mygame.sav";
+}
+
+bool SaveCommand::exec(const StringVector& args) {
+	if(args.size() != 2) {
+		print("Please give the name of the file. Type");
+		print("  ", args[0], " <file>");
+		return true;
+	}
+
+	std::ofstream file(args[1].c_str(), std::ios_base::binary);
+	if(!file.good() || !tm()->saveGame(file)) {
+		print("Unable to save the game in \"", args[1], "\".");
+	}
+	else {
+		print("Game saved in \"", args[1], "\".");
+	}
+
+	return true;
+}
+
+
+
+LoadCommand::LoadCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("load");
+
+	_desc = "  Load a game saved with the \"save\" command.";
+}
+
+bool LoadCommand::exec(const StringVector& args) {
+	if(args.size() != 2) {
+		print("Please give the name of the file. Type");
+		print("  ", args[0], " <file>");
+		return true;
+	}
+
+	std::ifstream file(args[1].c_str(), std::ios_base::binary);
+	String error = "unable to open the file";
+	if(!file.good() || !tm()->loadGame(file, &error)) {
+		print("Unable to load \"", args[1], "\": ", error, ".");
+	}
+	else {
+		print("Game loaded from \"", args[1], "\".");
+		tm()->execCommand("look");
+	}
+
+	return true;
+}
+
+
+
 RestartCommand::RestartCommand(TextMoba* textMoba)
     : TMCommand(textMoba)
     , _readClass(false)
@@ -479,3 +648,54 @@ bool RestartCommand::exec(const StringVector& args) {
 
 	return true;
 }
+
+
+
+PerfCommand::PerfCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("perf");
+
+	_desc = "  Show performance statistics.";
+}
+
+bool PerfCommand::exec(const StringVector& /*args*/) {
+	const SearchStats& stats = tm()->_searchStats;
+	Speculator* speculator = tm()->speculator();
+	if(speculator) {
+		print("Speculation: ", unsigned(speculator->_intentCount), " actions precomputed, ",
+		      speculator->_hits, " used, ", speculator->_misses, " missed.");
+	}
+
+	if(stats.searches == 0) {
+		print("Tree search: not used.");
+		return true;
+	}
+
+	double seconds = stats.time / 1000000.0;
+	print("Tree search: ", stats.searches, " searches on ", stats.threads,
+	      " threads, ", stats.playouts, " playouts in ", unsigned(seconds * 1000),
+	      " ms (", unsigned(seconds > 0? stats.playouts / seconds: 0), " playouts/s).");
+	print("  Last search: ", stats.lastPlayouts, " playouts in ",
+	      stats.lastTime / 1000, " ms, ", stats.lastNodes, " nodes.");
+
+	return true;
+}
+
+
+
+ReloadCommand::ReloadCommand(TextMoba* textMoba)
+    : TMCommand(textMoba)
+{
+	_names.emplace_back("reload");
+
+	_desc = "  Reload the AI behavior trees from the gameplay file.";
+}
+
+bool ReloadCommand::exec(const StringVector& /*args*/) {
+	if(tm()->reloadAi())
+		print("AI behavior trees reloaded.");
+	else
+		print("Failed to reload the AI behavior trees, see the log.");
+	return true;
+}
@@ -40,11 +40,18 @@ DECL_COMMAND(HelpCommand)
 DECL_COMMAND(InfoCommand)
 DECL_COMMAND(LookCommand)
 DECL_COMMAND(DirectionsCommand)
+DECL_COMMAND(LanesCommand)
 DECL_COMMAND(WaitCommand)
 DECL_COMMAND(GoCommand)
+DECL_COMMAND(GotoCommand)
 DECL_COMMAND(MoveCommand)
 DECL_COMMAND(AttackCommand)
 DECL_COMMAND(UseCommand)
+DECL_COMMAND(CallCommand)
+DECL_COMMAND(SaveCommand)
+DECL_COMMAND(LoadCommand)
+DECL_COMMAND(PerfCommand)
+DECL_COMMAND(ReloadCommand)
 
 class RestartCommand : public TMCommand {
 public:
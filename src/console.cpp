@@ -20,6 +20,7 @@
 
 
 #include <functional>
+#include <cstring>
 
 #include <lair/core/log.h>
 #include <lair/core/text.h>
@@ -31,11 +32,144 @@
 using namespace lair;
 
 
+ScrollbackBuffer::ScrollbackBuffer(unsigned maxLines)
+    : _maxLines(maxLines)
+    , _firstLine(0)
+    , _endLine(0)
+{
+}
+
+
+unsigned ScrollbackBuffer::maxLines() const {
+	return _maxLines;
+}
+
+
+void ScrollbackBuffer::setMaxLines(unsigned maxLines) {
+	_maxLines = maxLines;
+	while(_chunks.size() > 1 && size() - LINES_PER_CHUNK >= _maxLines) {
+		_chunks.pop_front();
+		_firstLine += LINES_PER_CHUNK;
+	}
+}
+
+
+unsigned ScrollbackBuffer::firstLine() const {
+	return _firstLine;
+}
+
+
+unsigned ScrollbackBuffer::endLine() const {
+	return _endLine;
+}
+
+
+unsigned ScrollbackBuffer::size() const {
+	return _endLine - _firstLine;
+}
+
+
+String ScrollbackBuffer::line(unsigned index) const {
+	lairAssert(index >= _firstLine && index < _endLine);
+
+	unsigned i = index - _firstLine;
+	const Chunk& chunk = _chunks[i / LINES_PER_CHUNK];
+	unsigned j = i % LINES_PER_CHUNK;
+	unsigned begin = j? chunk.ends[j - 1]: 0;
+	return String(chunk.text.data() + begin, chunk.text.data() + chunk.ends[j]);
+}
+
+
+const char* ScrollbackBuffer::lineData(unsigned index, unsigned* size) const {
+	lairAssert(index >= _firstLine && index < _endLine);
+
+	unsigned i = index - _firstLine;
+	const Chunk& chunk = _chunks[i / LINES_PER_CHUNK];
+	unsigned j = i % LINES_PER_CHUNK;
+	unsigned begin = j? chunk.ends[j - 1]: 0;
+	*size = chunk.ends[j] - begin;
+	return chunk.text.data() + begin;
+}
+
+
+void ScrollbackBuffer::push(const String& line) {
+	if(_chunks.empty() || _chunks.back().ends.size() == LINES_PER_CHUNK) {
+		_dropOldChunks();
+	}
+
+	Chunk& chunk = _chunks.back();
+	chunk.text.insert(chunk.text.end(), line.begin(), line.end());
+	chunk.ends.push_back(chunk.text.size());
+	_endLine += 1;
+}
+
+
+void ScrollbackBuffer::_dropOldChunks() {
+	// All the chunks are full here. If the oldest one is not needed to
+	// keep maxLines lines, recycle it as the new last chunk.
+	if(!_chunks.empty() && size() - LINES_PER_CHUNK >= _maxLines) {
+		Chunk chunk = std::move(_chunks.front());
+		_chunks.pop_front();
+		_firstLine += LINES_PER_CHUNK;
+
+		chunk.text.clear();
+		chunk.ends.clear();
+		_chunks.push_back(std::move(chunk));
+	}
+	else {
+		_chunks.emplace_back();
+		_chunks.back().ends.reserve(LINES_PER_CHUNK);
+	}
+}
+
+
+
+// Number of bytes in the UTF-8 sequence starting with lead.
+static inline unsigned utf8Size(unsigned char lead) {
+	if((lead & 0xe0) == 0xc0) return 2;
+	if((lead & 0xf0) == 0xe0) return 3;
+	if((lead & 0xf8) == 0xf0) return 4;
+	return 1;
+}
+
+
+// Length of the run of ASCII bytes starting at it, tested 8 bytes at a time.
+static inline unsigned asciiRun(const char* it, const char* end) {
+	const char* begin = it;
+	for(; end - it >= 8; it += 8) {
+		uint64 word;
+		std::memcpy(&word, it, 8);
+		if(word & 0x8080808080808080ull)
+			break;
+	}
+	while(it != end && (unsigned char)(*it) < 0x80)
+		++it;
+	return it - begin;
+}
+
+
+static unsigned utf8CharCount(const char* it, const char* end) {
+	unsigned count = 0;
+	while(it != end) {
+		unsigned run = asciiRun(it, end);
+		it    += run;
+		count += run;
+		if(it != end) {
+			it    += std::min<unsigned>(utf8Size(*it), end - it);
+			count += 1;
+		}
+	}
+	return count;
+}
+
+
+
 String Console::inputPrefix = "> ";
 
 
 Console::Console()
     : _cursorPos(inputPrefix.size())
+    , _lines(DEFAULT_MAX_LINES)
     , _inputSize(inputPrefix.size())
     , _input(inputPrefix)
 {
@@ -53,13 +187,38 @@ void Console::setCursorPos(unsigned pos) {
 }
 
 
+unsigned Console::maxLines() const {
+	return _lines.maxLines();
+}
+
+
+void Console::setMaxLines(unsigned maxLines) {
+	_lines.setMaxLines(maxLines);
+}
+
+
+unsigned Console::firstLine() const {
+	return _lines.firstLine();
+}
+
+
+unsigned Console::endLine() const {
+	return _lines.endLine();
+}
+
+
 unsigned Console::lineCount() const {
 	return _lines.size();
 }
 
 
-const String& Console::line(unsigned i) const {
-	return _lines.at(i);
+String Console::line(unsigned i) const {
+	return _lines.line(i);
+}
+
+
+const char* Console::lineData(unsigned i, unsigned* size) const {
+	return _lines.lineData(i, size);
 }
 
 
@@ -70,18 +229,12 @@ void Console::writeLine(const String& line) {
 
 	for(; it != end; ++it) {
 		if(*it == '\n') {
-			_lines.emplace_back(lineBegin, it);
-			if(onAddLine)
-				onAddLine(_lines.back());
-//			dbgLogger.log(_lines.back());
+			_addLine(String(lineBegin, it));
 			lineBegin = it + 1;
 		}
 	}
 
-	_lines.emplace_back(lineBegin, it);
-	if(onAddLine)
-		onAddLine(_lines.back());
-//	dbgLogger.log(_lines.back());
+	_addLine(String(lineBegin, it));
 }
 
 
@@ -153,145 +306,304 @@ void Console::execLine() {
 }
 
 
+void Console::_addLine(const String& line) {
+	_lines.push(line);
+	if(onAddLine)
+		onAddLine(line);
+//	dbgLogger.log(line);
+}
+
+
 
 ConsoleView::ConsoleView(Console* console, unsigned width, unsigned height)
     : _console(console)
     , _width(width)
     , _height(height)
-    , _scrollPos(-1)
+    , _following(true)
+    , _scroll{0, 0}
+    , _wrapBegin(0)
+    , _generation(1)
+    , _textGeneration(0)
+    , _inputRow(0)
+    , _cursor(-1, -1)
+    , _cursorGeneration(0)
+    , _cursorPos(0)
 {
 	using namespace std::placeholders;
 
 	_console->onAddLine     = std::bind(&ConsoleView::_addLine,     this, _1);
 	_console->onUpdateInput = std::bind(&ConsoleView::_updateInput, this, _1);
 
-	_inputLines.emplace_back();
-
 	_updateInput(_console->input());
 }
 
 
-unsigned ConsoleView::lineCount() const {
-	return _viewLines.size() + _inputLines.size();
+unsigned ConsoleView::width() const {
+	return _width;
 }
 
 
-String ConsoleView::text(Vector2i* cursor) const {
-	int offset = realScrollPos();
+unsigned ConsoleView::height() const {
+	return _height;
+}
 
-	if(cursor)
-		*cursor = Vector2i(-1, -1);
 
-	String text;
-	int end = std::min<int>(offset + _height, _viewLines.size());
-	int row = 0;
-	for(int i = offset; i < end; ++i, ++row) {
-		text.push_back('\n');
-		text.append(_viewLines[i]);
-	}
+void ConsoleView::resize(unsigned width, unsigned height) {
+	if(width == _width && height == _height)
+		return;
 
-	end = std::min<int>(_inputLines.size(), _height - row);
-	unsigned inputPos = 0;
-	unsigned consoleCursor = _console->cursorPos();
-	for(int i = 0; i < end; ++i, ++row) {
-		text.push_back('\n');
-		text.append(_inputLines[i]);
+	_width  = width;
+	_height = height;
 
-		unsigned size = charCount(_inputLines[i]);
-		if(cursor && inputPos <= consoleCursor) {
-			*cursor = Vector2i(consoleCursor - inputPos,
-			                   row);
-		}
-		inputPos += size + 1;
-	}
+	_inputRows.clear();
+	_wrapLine(_inputRows, _input.data(), _input.data() + _input.size());
+	_generation += 1;
+}
 
-	for(; row < int(_height); ++row)
-		text.push_back('\n');
 
-	return text;
+unsigned ConsoleView::generation() const {
+	return _generation;
 }
 
 
-int ConsoleView::scrollPos() const {
-	return _scrollPos;
+const String& ConsoleView::text() const {
+	if(_textGeneration != _generation)
+		_composeText();
+	return _text;
 }
 
 
-int ConsoleView::realScrollPos() const {
-	if(_scrollPos < 0) {
-		return std::max(0, maxScrollPos() + _scrollPos + 1);
-	}
-	return _scrollPos;
+Vector2i ConsoleView::cursor() const {
+	if(_cursorGeneration != _generation || _cursorPos != _console->cursorPos())
+		_computeCursor();
+	return _cursor;
 }
 
 
-int ConsoleView::maxScrollPos() const {
-	return std::max<int>(0, lineCount() - _height);
+bool ConsoleView::isFollowing() const {
+	return _following;
 }
 
 
-void ConsoleView::scrollTo(int scrollPos) {
-	if(scrollPos < maxScrollPos()) {
-		_scrollPos = scrollPos;
+void ConsoleView::scroll(int offset) {
+	// Finding the bottom wraps the last lines, only do it when needed.
+	bool   needBottom = _following || offset > 0;
+	Anchor bottom = needBottom? _bottomAnchor(): Anchor{0, 0};
+	Anchor top    = _following? bottom: _topAnchor();
+	unsigned first = _console->firstLine();
+
+	for(; offset < 0 && (top.line > first || top.row > 0); ++offset) {
+		if(top.row > 0) {
+			top.row -= 1;
+		}
+		else {
+			top.line -= 1;
+			top.row   = _wrapped(top.line).size() - 1;
+		}
 	}
-	else {
-		_scrollPos = -1;
+
+	for(; offset > 0 && top < bottom; --offset) {
+		top.row += 1;
+		if(top.row == _wrapped(top.line).size()) {
+			top.line += 1;
+			top.row   = 0;
+		}
+	}
+
+	bool following = needBottom && !(top < bottom);
+	if(following != _following || (!following && (top < _scroll || _scroll < top))) {
+		_following = following;
+		_scroll    = top;
+		_generation += 1;
 	}
 }
 
 
-void ConsoleView::scroll(int offset) {
-	int real = realScrollPos();
-	if(offset < 0 && -offset > real) {
-		scrollTo(0);
-	}
-	else {
-		scrollTo(real + offset);
+void ConsoleView::scrollToBottom() {
+	if(!_following) {
+		_following = true;
+		_generation += 1;
 	}
 }
 
 
-void ConsoleView::_addLine(const String& line) {
-	_viewFromConsole.emplace_back(_viewLines.size());
-	_appendLines(_viewLines, line);
+void ConsoleView::_addLine(const String& /*line*/) {
+	// Lines are wrapped lazily, when they become visible.
+	_generation += 1;
 }
 
 
 void ConsoleView::_updateInput(const String& input) {
-	_inputLines.clear();
-	_appendLines(_inputLines, input);
-	scrollTo(-1);
+	_input = input;
+	_inputRows.clear();
+	_wrapLine(_inputRows, _input.data(), _input.data() + _input.size());
+	_generation += 1;
+	scrollToBottom();
 }
 
 
-void ConsoleView::_appendLines(StringDeque& lines, const String& line) {
-	auto it        = line.begin();
-	auto end       = line.end();
+void ConsoleView::_wrapLine(RowVector& rows, const char* begin, const char* end) const {
+	const char* it = begin;
 
 	if(it == end) {
-		lines.emplace_back();
+		rows.push_back(Row{0, 0});
 	}
 
 	while(it != end) {
-		auto lineBegin = it;
-		auto lineEnd   = it;
+		const char* lineBegin = it;
+		const char* lineEnd   = it;
 		unsigned count = 0;
 		while(it != end && count < _width) {
-			if(std::isspace(*it))
-				lineEnd = it;
-			it = nextCharacter(line, it);
-			count += 1;
+			// Console text is mostly ASCII, where a byte is a character:
+			// handle whole runs at once and only decode the rest.
+			unsigned run = std::min(asciiRun(it, end), _width - count);
+			if(run) {
+				for(const char* c = it + run; c != it; --c) {
+					if(std::isspace(c[-1])) {
+						lineEnd = c - 1;
+						break;
+					}
+				}
+				it    += run;
+				count += run;
+			}
+			else {
+				it    += std::min<unsigned>(utf8Size(*it), end - it);
+				count += 1;
+			}
 		}
 
 		if(it == end || lineEnd == lineBegin) {
 			lineEnd = it;
 		}
 		else {
-			it = nextCharacter(line, lineEnd);
+			it = lineEnd + utf8Size(*lineEnd);
 		}
 
-		unsigned b = lineBegin - line.begin();
-		unsigned e = lineEnd - line.begin();
-		lines.emplace_back(line.substr(b, e - b));
+		rows.push_back(Row{unsigned(lineBegin - begin), unsigned(lineEnd - begin)});
+	}
+}
+
+
+const ConsoleView::RowVector& ConsoleView::_wrapped(unsigned line) const {
+	unsigned end = _wrapBegin + _wrapCache.size();
+	if(_wrapCache.empty() || line + 1 < _wrapBegin || line > end) {
+		_wrapCache.clear();
+		_wrapBegin = line;
+		end        = line;
+	}
+
+	if(line == end) {
+		_wrapCache.emplace_back();
 	}
+	else if(line + 1 == _wrapBegin) {
+		_wrapCache.emplace_front();
+		_wrapBegin = line;
+	}
+
+	// Lines wrapped for another width are wrapped again when needed.
+	WrappedLine& wrapped = _wrapCache[line - _wrapBegin];
+	if(wrapped.rows.empty() || wrapped.width != _width) {
+		unsigned size;
+		const char* data = _console->lineData(line, &size);
+		wrapped.width = _width;
+		wrapped.rows.clear();
+		_wrapLine(wrapped.rows, data, data + size);
+	}
+
+	return wrapped.rows;
+}
+
+
+void ConsoleView::_trimWrapped(unsigned begin, unsigned end) const {
+	begin = (begin > _height)? begin - _height: 0;
+	end  += _height;
+
+	while(!_wrapCache.empty() && _wrapBegin < begin) {
+		_wrapCache.pop_front();
+		_wrapBegin += 1;
+	}
+	while(!_wrapCache.empty() && _wrapBegin + _wrapCache.size() > end) {
+		_wrapCache.pop_back();
+	}
+}
+
+
+ConsoleView::Anchor ConsoleView::_bottomAnchor() const {
+	unsigned first = _console->firstLine();
+	unsigned line  = _console->endLine();
+	int rows = int(_height) - int(_inputRows.size());
+
+	while(rows > 0 && line > first) {
+		line -= 1;
+		int count = _wrapped(line).size();
+		if(count >= rows)
+			return Anchor{line, unsigned(count - rows)};
+		rows -= count;
+	}
+
+	return Anchor{line, 0};
+}
+
+
+ConsoleView::Anchor ConsoleView::_topAnchor() const {
+	// The line at the top may have been dropped from the scrollback.
+	if(_scroll.line < _console->firstLine())
+		return Anchor{_console->firstLine(), 0};
+	// And it may have less rows since a resize.
+	unsigned rows = _wrapped(_scroll.line).size();
+	return Anchor{_scroll.line, std::min(_scroll.row, rows - 1)};
+}
+
+
+void ConsoleView::_composeText() const {
+	Anchor top = _following? _bottomAnchor(): _topAnchor();
+	unsigned end = _console->endLine();
+
+	_text.clear();
+	int row = 0;
+	unsigned line = top.line;
+	for(unsigned sub = top.row; line < end && row < int(_height); ++line, sub = 0) {
+		const RowVector& rows = _wrapped(line);
+		unsigned size;
+		const char* data = _console->lineData(line, &size);
+		for(; sub < rows.size() && row < int(_height); ++sub, ++row) {
+			_text.push_back('\n');
+			_text.append(data + rows[sub].begin, data + rows[sub].end);
+		}
+	}
+
+	_inputRow = row;
+	int inputEnd = std::min<int>(_inputRows.size(), _height - row);
+	for(int i = 0; i < inputEnd; ++i, ++row) {
+		_text.push_back('\n');
+		_text.append(_input, _inputRows[i].begin, _inputRows[i].end - _inputRows[i].begin);
+	}
+
+	_text.append(std::max(0, int(_height) - row), '\n');
+
+	_trimWrapped(top.line, line);
+	_textGeneration = _generation;
+}
+
+
+void ConsoleView::_computeCursor() const {
+	if(_textGeneration != _generation)
+		_composeText();
+
+	_cursor = Vector2i(-1, -1);
+	int row = _inputRow;
+	int end = std::min<int>(_inputRows.size(), _height - row);
+	unsigned inputPos = 0;
+	unsigned consoleCursor = _console->cursorPos();
+	for(int i = 0; i < end; ++i, ++row) {
+		if(inputPos <= consoleCursor) {
+			_cursor = Vector2i(consoleCursor - inputPos, row);
+		}
+		inputPos += utf8CharCount(_input.data() + _inputRows[i].begin,
+		                          _input.data() + _inputRows[i].end) + 1;
+	}
+
+	_cursorGeneration = _generation;
+	_cursorPos        = consoleCursor;
 }
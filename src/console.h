@@ -29,6 +29,50 @@
 #include <lair/core/lair.h>
 
 
+// Stores the console history in chunks of LINES_PER_CHUNK lines. The text of
+// a chunk is kept in a single buffer, so a line costs its size plus an offset.
+// Lines are indexed by their absolute number since the start, which gives
+// O(1) random access. When there are more than maxLines lines, the oldest
+// chunks are dropped and their buffers reused for new lines.
+class ScrollbackBuffer {
+public:
+	static const unsigned LINES_PER_CHUNK = 1024;
+
+public:
+	ScrollbackBuffer(unsigned maxLines);
+
+	unsigned maxLines() const;
+	void setMaxLines(unsigned maxLines);
+
+	// Absolute index of the oldest line still stored.
+	unsigned firstLine() const;
+	// Absolute index of the next line to be pushed.
+	unsigned endLine() const;
+	unsigned size() const;
+
+	lair::String line(unsigned index) const;
+	// Text of a line without a copy, valid until the next push.
+	const char* lineData(unsigned index, unsigned* size) const;
+	void push(const lair::String& line);
+
+private:
+	struct Chunk {
+		std::vector<char>     text;
+		std::vector<unsigned> ends;
+	};
+	typedef std::deque<Chunk> ChunkDeque;
+
+private:
+	void _dropOldChunks();
+
+private:
+	unsigned   _maxLines;
+	unsigned   _firstLine;
+	unsigned   _endLine;
+	ChunkDeque _chunks;
+};
+
+
 class Console {
 public:
 	typedef std::function<void(const lair::String&)> ExecCommand;
@@ -38,14 +82,24 @@ public:
 
 	static lair::String inputPrefix;
 
+	static const unsigned DEFAULT_MAX_LINES = 64 * ScrollbackBuffer::LINES_PER_CHUNK;
+
 public:
 	Console();
 
 	unsigned cursorPos() const;
 	void setCursorPos(unsigned pos);
 
+	unsigned maxLines() const;
+	void setMaxLines(unsigned maxLines);
+
+	// Lines are indexed from the start of the session. Only the lines in
+	// [firstLine(), endLine()) are still available.
+	unsigned firstLine() const;
+	unsigned endLine() const;
 	unsigned lineCount() const;
-	const lair::String& line(unsigned i) const;
+	lair::String line(unsigned i) const;
+	const char* lineData(unsigned i, unsigned* size) const;
 	void writeLine(const lair::String& line);
 
 	const lair::String& input() const;
@@ -64,11 +118,11 @@ public:
 	UpdateInputCallback onUpdateInput;
 
 private:
-	typedef std::deque<lair::String> StringDeque;
+	void _addLine(const lair::String& line);
 
 private:
 	unsigned     _cursorPos;
-	StringDeque  _lines;
+	ScrollbackBuffer _lines;
 	unsigned     _inputSize;
 	lair::String _input;
 
@@ -80,33 +134,85 @@ class ConsoleView {
 public:
 	ConsoleView(Console* console, unsigned width, unsigned height);
 
-	unsigned lineCount() const;
-	lair::String text(lair::Vector2i* cursor = nullptr) const;
-
-	int scrollPos() const;
-	int realScrollPos() const;
-	int maxScrollPos() const;
-	void scrollTo(int scrollPos);
+	unsigned width() const;
+	unsigned height() const;
+	// Lines are rewrapped lazily, when they become visible.
+	void resize(unsigned width, unsigned height);
+
+	// Bumped each time the visible text changes, so that users can skip
+	// the update (and the layout) of their copy.
+	unsigned generation() const;
+	// The visible text, only rebuilt when the generation changed.
+	const lair::String& text() const;
+	// Position of the console cursor, in characters, or (-1, -1) if it is
+	// not visible.
+	lair::Vector2i cursor() const;
+
+	// The view follows new lines unless it has been scrolled up.
+	bool isFollowing() const;
 	void scroll(int offset);
+	void scrollToBottom();
 
 	void _addLine(const lair::String& line);
 	void _updateInput(const lair::String& input);
 
 private:
-	typedef std::deque<unsigned>     UnsignedDeque;
-	typedef std::deque<lair::String> StringDeque;
+	// A row of wrapped text, as byte offsets in its line.
+	struct Row {
+		unsigned begin;
+		unsigned end;
+	};
+	typedef std::vector<Row> RowVector;
+
+	struct WrappedLine {
+		unsigned  width;
+		RowVector rows;
+	};
+	typedef std::deque<WrappedLine> WrappedDeque;
+
+	// A row of the history, as a console line and a row in its wrapped text.
+	struct Anchor {
+		unsigned line;
+		unsigned row;
+
+		bool operator<(const Anchor& other) const {
+			return line < other.line || (line == other.line && row < other.row);
+		}
+	};
 
 private:
-	void _appendLines(StringDeque& lines, const lair::String& line);
+	void _wrapLine(RowVector& rows, const char* begin, const char* end) const;
+	const RowVector& _wrapped(unsigned line) const;
+	void _trimWrapped(unsigned begin, unsigned end) const;
+
+	Anchor _bottomAnchor() const;
+	Anchor _topAnchor() const;
+
+	void _composeText() const;
+	void _computeCursor() const;
 
 private:
 	Console*      _console;
 	unsigned      _width;
 	unsigned      _height;
-	UnsignedDeque _viewFromConsole;
-	StringDeque   _viewLines;
-	StringDeque   _inputLines;
-	int           _scrollPos;
+	lair::String  _input;
+	RowVector     _inputRows;
+	bool          _following;
+	Anchor        _scroll;
+
+	// Wrapped rows of the console lines [_wrapBegin, _wrapBegin + size), only
+	// kept around the visible window.
+	mutable WrappedDeque _wrapCache;
+	mutable unsigned     _wrapBegin;
+
+	unsigned      _generation;
+	// Caches of text() and cursor(), with the state they were computed for.
+	mutable lair::String   _text;
+	mutable unsigned       _textGeneration;
+	mutable int            _inputRow;
+	mutable lair::Vector2i _cursor;
+	mutable unsigned       _cursorGeneration;
+	mutable unsigned       _cursorPos;
 };
 
 
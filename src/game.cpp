@@ -86,7 +86,9 @@ void Game::initialize() {
 	_splashState->setNextState(_mainState.get());
 	_splashState->addSplash("TitleScreen.png");
 
+	// The main state is loaded while the splash screen plays.
 	_mainState->initialize();
+	_splashState->setLoadStep(std::bind(&MainState::loadStep, _mainState.get()));
 }
 
 
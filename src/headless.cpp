@@ -0,0 +1,308 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+
+#include <lair/core/log.h>
+
+#include "character.h"
+#include "state_hash.h"
+
+#include "headless.h"
+
+
+using namespace lair;
+
+
+Headless::Headless(std::istream* in, std::ostream* out, bool quiet)
+    : _in(in)
+    , _out(out)
+    , _quiet(quiet)
+    , _console()
+    , _textMoba(nullptr, &_console)
+    , _recorder(&_textMoba)
+    , _checkSim(false)
+    , _simErrors(0)
+{
+	using namespace std::placeholders;
+
+	// Lines are streamed to the output, the console only needs to keep
+	// the last ones.
+	_console.setMaxLines(0);
+	_console.onAddLine = std::bind(&Headless::_addLine, this, _1);
+	_textMoba.onGameOver = std::bind(&Headless::_gameOver, this, _1);
+
+	// Nobody reads the debug log in headless mode, unless asked to.
+	_textMoba.removeMessageSink(&_textMoba.logSink());
+	if(_quiet) {
+		_textMoba.removeMessageSink(&_textMoba.consoleSink());
+	}
+}
+
+
+void Headless::setVerbose(bool verbose) {
+	_textMoba.removeMessageSink(&_textMoba.logSink());
+	if(verbose) {
+		_textMoba.addMessageSink(&_textMoba.logSink());
+	}
+}
+
+
+void Headless::setTraceHash(bool traceHash) {
+	if(traceHash)
+		_textMoba.onTurnEnd = std::bind(&Headless::_turnEnd, this);
+	else
+		_textMoba.onTurnEnd = nullptr;
+}
+
+
+void Headless::setCheckSim(bool checkSim) {
+	_checkSim = checkSim;
+}
+
+
+void Headless::initialize(const Path& logicPath) {
+	_textMoba.initialize(logicPath);
+}
+
+
+void Headless::run() {
+	String line;
+
+	// The prompt tells a bot driving us that the previous command is
+	// completely processed. Commands can be sent ahead of it.
+	if(!_quiet) {
+		*_out << Console::inputPrefix << std::flush;
+	}
+
+	while(std::getline(*_in, line)) {
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		if(_checkSim) {
+			_checkSimTurn(line);
+		}
+		else {
+			_textMoba._execCommand(line);
+		}
+
+		if(!_quiet) {
+			*_out << Console::inputPrefix;
+		}
+		_out->flush();
+	}
+
+	if(!_quiet) {
+		*_out << "\n";
+	}
+	_out->flush();
+}
+
+
+bool Headless::replay(const Replay& replay, bool verify, bool realTime) {
+	bool ok = playReplay(&_textMoba, replay, verify, realTime, &std::cerr);
+	_out->flush();
+	return ok;
+}
+
+
+void Headless::_checkSimTurn(const String& line) {
+	const SimModel& model = _textMoba.simModel();
+
+	bool wait = (line == "w" || line == "wait");
+	if(wait)
+		model.capture(&_textMoba, _simState);
+
+	unsigned turn = _textMoba._turn;
+	_textMoba._execCommand(line);
+
+	if(!wait || _textMoba._turn != turn + 1)
+		return;
+
+	SimAction action = { SIM_WAIT, 0, 0 };
+	model.step(_simState, action);
+	if(_simState.result != SIM_RUNNING)
+		return;
+
+	uint64 expected = _textMoba.stateHash();
+	uint64 simHash  = model.stateHash(_simState);
+	if(simHash != expected) {
+		_simErrors += 1;
+		std::cerr << "Forward model diverges at turn " << _textMoba._turn
+		          << ": " << hashToString(simHash) << " instead of "
+		          << hashToString(expected) << ".\n";
+	}
+}
+
+
+void Headless::_addLine(const String& line) {
+	_out->write(line.data(), line.size());
+	_out->put('\n');
+}
+
+
+void Headless::_gameOver(bool win) {
+	if(!_quiet)
+		return;
+
+	CharacterSP player = _textMoba.player();
+	*_out << (win? "win": "loss")
+	      << " turn " << _textMoba._turn;
+	if(player) {
+		*_out << " " << player->className()
+		      << " lvl " << player->level() + 1;
+	}
+	*_out << "\n";
+}
+
+
+void Headless::_turnEnd() {
+	// Written even in quiet mode: this is meant to diff two engines.
+	*_out << "hash " << _textMoba._turn << " "
+	      << hashToString(_textMoba.stateHash()) << "\n";
+}
+
+
+bool isHeadless(int argc, char** argv) {
+	for(int i = 1; i < argc; ++i) {
+		if(String(argv[i]) == "--headless")
+			return true;
+	}
+	return false;
+}
+
+
+int runHeadless(int argc, char** argv) {
+	bool   quiet     = false;
+	bool   verbose   = false;
+	String inputPath;
+	String dataPath  = "assets";
+	String recordPath;
+	String replayPath;
+	bool   verify    = false;
+	bool   realTime  = false;
+	bool   traceHash = false;
+	bool   checkSim  = false;
+	int    playouts  = -1;
+	uint64 seed      = time(nullptr);
+
+	for(int i = 1; i < argc; ++i) {
+		String arg = argv[i];
+		if(arg == "--headless") {
+		}
+		else if(arg == "--quiet" || arg == "-q") {
+			quiet = true;
+		}
+		else if(arg == "--verbose" || arg == "-v") {
+			verbose = true;
+		}
+		else if(arg == "--input" && i + 1 < argc) {
+			inputPath = argv[++i];
+		}
+		else if(arg == "--data" && i + 1 < argc) {
+			dataPath = argv[++i];
+		}
+		else if(arg == "--seed" && i + 1 < argc) {
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if(arg == "--record" && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if(arg == "--replay" && i + 1 < argc) {
+			replayPath = argv[++i];
+		}
+		else if(arg == "--verify") {
+			verify = true;
+		}
+		else if(arg == "--realtime") {
+			realTime = true;
+		}
+		else if(arg == "--trace-hash") {
+			traceHash = true;
+		}
+		else if(arg == "--check-sim") {
+			checkSim = true;
+		}
+		else if(arg == "--search-playouts" && i + 1 < argc) {
+			playouts = std::atoi(argv[++i]);
+		}
+		else {
+			std::cerr << "Usage: " << argv[0] << " --headless [--quiet] [--verbose] "
+			          << "[--input <file>] [--data <assets-dir>] [--seed <n>] "
+			          << "[--trace-hash] [--check-sim] [--search-playouts <n>] "
+			          << "[--record <file>] "
+			          << "[--replay <file> [--verify] [--realtime]]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::ios_base::sync_with_stdio(false);
+	std::cin.tie(nullptr);
+
+	std::ifstream file;
+	std::istream* in = &std::cin;
+	if(!inputPath.empty()) {
+		file.open(inputPath.c_str());
+		if(!file.good()) {
+			std::cerr << "Unable to read \"" << inputPath << "\".\n";
+			return EXIT_FAILURE;
+		}
+		in = &file;
+	}
+
+	Replay replay;
+	if(!replayPath.empty()) {
+		std::ifstream replayFile(replayPath.c_str(), std::ios_base::binary);
+		String error;
+		if(!replay.read(replayFile, &error)) {
+			std::cerr << "Unable to read replay \"" << replayPath << "\": "
+			          << error << ".\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	Headless headless(in, &std::cout, quiet);
+	headless.setVerbose(verbose);
+	headless.setTraceHash(traceHash);
+	headless.setCheckSim(checkSim);
+	headless._textMoba.seed(seed);
+	headless.initialize(Path(dataPath + "/gameplay.ldl"));
+	if(playouts >= 0) {
+		headless._textMoba._searchPlayouts = playouts;
+	}
+
+	if(!recordPath.empty() && !headless._recorder.open(recordPath)) {
+		std::cerr << "Unable to write replay \"" << recordPath << "\".\n";
+		return EXIT_FAILURE;
+	}
+
+	if(!replayPath.empty()) {
+		bool ok = headless.replay(replay, verify, realTime);
+		return ok? EXIT_SUCCESS: EXIT_FAILURE;
+	}
+
+	headless.run();
+
+	return headless._simErrors? EXIT_FAILURE: EXIT_SUCCESS;
+}
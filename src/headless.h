@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_HEADLESS_H_
+#define LD41_HEADLESS_H_
+
+
+#include <iostream>
+
+#include <lair/core/lair.h>
+#include <lair/core/path.h>
+
+#include "console.h"
+#include "text_moba.h"
+#include "replay.h"
+#include "sim_state.h"
+
+
+// Runs the game without SDL: commands are read line by line from an input
+// stream and the console output is streamed to an output stream.
+class Headless {
+public:
+	Headless(std::istream* in, std::ostream* out, bool quiet = false);
+
+	void setVerbose(bool verbose);
+	void setTraceHash(bool traceHash);
+	void setCheckSim(bool checkSim);
+
+	void initialize(const lair::Path& logicPath);
+	void run();
+	bool replay(const Replay& replay, bool verify, bool realTime);
+
+	void _addLine(const lair::String& line);
+	void _gameOver(bool win);
+	void _turnEnd();
+	void _checkSimTurn(const lair::String& line);
+
+public:
+	std::istream*  _in;
+	std::ostream*  _out;
+	bool           _quiet;
+
+	Console        _console;
+	TextMoba       _textMoba;
+	ReplayRecorder _recorder;
+
+	bool           _checkSim;
+	SimState       _simState;
+	unsigned       _simErrors;
+};
+
+
+bool isHeadless(int argc, char** argv);
+int runHeadless(int argc, char** argv);
+
+
+#endif
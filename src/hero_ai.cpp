@@ -24,6 +24,7 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "character.h"
+#include "binary_io.h"
 
 #include "hero_ai.h"
 
@@ -35,104 +36,75 @@ HeroAi::HeroAi(CharacterSP character, Lane lane)
     : Ai(character)
     , _status(PUSH_LANE)
     , _lane(lane)
+    , _plan{ PLAN_NONE, 0, 0 }
 {
 }
 
 
+AiType HeroAi::type() const {
+	return AI_HERO;
+}
+
+
 void HeroAi::play() {
 	CharacterSP c = character();
 
 	if(!c || !c->isAlive())
 		return;
 
-	_groups = c->node()->characterGroups();
-
-//	dbgLogger.log(c->debugName(), " turn:");
-
-	// Back when low health
-	if(c->hp() < c->maxHP() / 4) {
-		_status = BACK_TO_BASE;
-	}
-	if(c->hp() == c->maxHP() && c->mana() == c->maxMana()) {
-		// TODO: remember previous status and reset it.
-		_status = PUSH_LANE;
+	AiAgent agent = _agent(c);
+	const BehaviorTrees& trees = c->_textMoba->behaviorTrees();
+	trees.run(BT_HERO_STATUS, agent);
+	if(!resumePlan(_plan, agent)) {
+		trees.run(BT_HERO, agent);
+		// The tree may have started a plan, which plays its first step now.
+		resumePlan(_plan, agent);
 	}
+}
 
-	switch(_status) {
-	case PUSH_LANE: {
-		unsigned enemyCount = _groups.count(c->enemyTeam());
-		unsigned towerCount = _groups.count(BUILDING, c->team());
-		unsigned redshirtCount = _groups.count(REDSHIRT, c->team());
-
-		if(enemyCount && !redshirtCount && !towerCount) {
-			// Back if it doesn't look good.
-			move(BACKWARD);
-		}
-		else if(enemyCount) {
-			if(c->range() == 1 && c->place() == BACK) {
-				c->goToPlace(FRONT);
-			}
-			else {
-				attackClosest();
-			}
-		}
-		else if(redshirtCount) {
-			move(FORWARD);
-		}
-		break;
-	}
 
-	case FOLLOW_PLAYER: {
-		// TODO: Follow and mimic player
-		break;
-	}
+void HeroAi::updateStatus() {
+	CharacterSP c = character();
 
-	case BACK_TO_BASE: {
-		// TODO: TP to base from somewhere safe
-		if(c->node() == c->_textMoba->fonxus(c->team())) {
-			// Attack enemies at the Fonxus.
-			if(_groups.count(c->enemyTeam())) {
-				attackClosest();
-			}
-		}
-		else {
-			move(BACKWARD);
-		}
-		break;
-	}
-	}
-}
+	if(!c || !c->isAlive())
+		return;
 
+	AiAgent agent = _agent(c);
+	c->_textMoba->behaviorTrees().run(BT_HERO_STATUS, agent);
+}
 
-void HeroAi::attackClosest() {
-	// TODO: Attack player target in FOLLOW_PLAYER mode ?
 
-	CharacterSP target = _target.lock();
+void HeroAi::startPlan(AiPlanType plan, unsigned turn) {
+	_plan.type  = plan;
+	_plan.step  = 0;
+	_plan.start = turn;
+}
 
-	if(!target || !target->isAlive() ||
-	        _groups.distanceBetween(character(), target) > character()->range()) {
-		target = _groups.pickClosestEnemy(character());
-	}
 
-	if(target) {
-		_target = target;
-		character()->attack(target);
-	}
+AiAgent HeroAi::_agent(CharacterSP character) {
+	AiAgent agent(character, &_target);
+	agent._lane = &_lane;
+	agent._hero = this;
+	return agent;
 }
 
 
-bool HeroAi::move(Dir direction) {
-	Team dir = (direction == FORWARD)?
-	               character()->enemyTeam():
-	               character()->team();
-	MapNodeSP dest = character()->node()->destination(teamName(dir));
-	if(!dest) {
-		dest = character()->node()->destination(laneName(_lane));
-	}
+void HeroAi::write(BinaryWriter& writer) const {
+	writer.writeUInt(_status);
+	writer.writeUInt(_lane);
+	writeCharacterRef(writer, _target.lock());
+	writer.writeUInt(_plan.type);
+	writer.writeUInt(_plan.step);
+	writer.writeUInt(_plan.start);
+}
 
-	if(dest) {
-		character()->moveTo(dest);
-	}
 
-	return bool(dest);
+void HeroAi::read(BinaryReader& reader, const CharacterIndexMap& characters) {
+	_status = Status(std::min<uint64>(reader.readUInt(), BACK_TO_BASE));
+	_lane   = Lane(reader.readUInt() & 0x01);
+	_target = readCharacterRef(reader, characters);
+
+	_plan.type  = std::min<uint64>(reader.readUInt(), PLAN_COUNT - 1);
+	_plan.step  = std::min<uint64>(reader.readUInt(), aiPlans[_plan.type].stepCount);
+	_plan.start = reader.readUInt();
 }
@@ -26,6 +26,7 @@
 #include <lair/core/lair.h>
 
 #include "map_node.h"
+#include "ai_plan.h"
 
 #include "ai.h"
 
@@ -46,17 +47,26 @@ public:
 public:
 	HeroAi(CharacterSP character, Lane lane);
 
+	virtual AiType type() const override;
+
 	virtual void play() override;
 
-	void attackClosest();
-	bool move(Dir direction);
+	virtual void write(BinaryWriter& writer) const override;
+	virtual void read(BinaryReader& reader, const CharacterIndexMap& characters) override;
+
+	// Runs the "hero_status" behavior tree only.
+	void updateStatus();
+
+	// Starts a plan, that replaces the "hero" behavior tree until it ends.
+	void startPlan(AiPlanType plan, unsigned turn);
+
+	AiAgent _agent(CharacterSP character);
 
 public:
 	Status      _status;
 	Lane        _lane;
 	CharacterWP _target;
-
-	CharacterGroups _groups;
+	AiPlanState _plan;
 };
 
 
@@ -0,0 +1,59 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "lane_planner.h"
+
+
+using namespace lair;
+
+
+void LanePlan::solve(unsigned travelCost, unsigned switchCost) {
+	unsigned count = std::min<unsigned>(heroCount, MAX_HEROES);
+
+	// Bit h of mask set means hero h goes bot. Ties go to the first mask.
+	unsigned bestMask = 0;
+	int64    bestCost = std::numeric_limits<int64>::max();
+	for(unsigned mask = 0; mask < (1u << count); ++mask) {
+		int64 load[2] = { need[TOP], need[BOT] };
+		int64 cost    = 0;
+		for(unsigned h = 0; h < count; ++h) {
+			const Hero& hero = heroes[h];
+			Lane lane = ((mask >> h) & 1)? BOT: TOP;
+			load[lane] -= hero.strength;
+			cost += int64(travelCost) * hero.distance[lane];
+			if(lane != hero.lane)
+				cost += switchCost;
+		}
+		cost += std::abs(load[TOP]) + std::abs(load[BOT]);
+
+		if(cost < bestCost) {
+			bestCost = cost;
+			bestMask = mask;
+		}
+	}
+
+	for(unsigned h = 0; h < count; ++h)
+		heroes[h].lane = ((bestMask >> h) & 1)? BOT: TOP;
+}
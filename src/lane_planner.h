@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_LANE_PLANNER_H_
+#define LD41_LANE_PLANNER_H_
+
+
+#include <lair/core/lair.h>
+
+#include "text_moba.h"
+
+
+// Team-level assignment of the AI heroes to the lanes. TextMoba (and
+// SimModel, the same way) runs it every few turns and when a tower dies or a
+// hero respawns, instead of having each hero reconsider its lane each turn.
+//
+// need is the enemy hp on each lane minus the allied hp that is not planned.
+// The best assignment matches the hero strengths to the needs while keeping
+// travels and lane changes low. There is only a handful of heroes, so all
+// the assignments are tried.
+struct LanePlan {
+	enum {
+		MAX_HEROES = 8,
+	};
+
+	struct Hero {
+		unsigned strength;
+		unsigned distance[2];
+		Lane     lane;
+	};
+
+	int      need[2];
+	unsigned heroCount;
+	Hero     heroes[MAX_HEROES];
+
+	// travelCost and switchCost are in hp, per node and per lane change.
+	// Updates the lane of each hero.
+	void solve(unsigned travelCost, unsigned switchCost);
+};
+
+
+#endif
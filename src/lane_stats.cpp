@@ -0,0 +1,201 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <cstring>
+
+#include <lair/core/log.h>
+
+#include "map_node.h"
+#include "character.h"
+
+#include "lane_stats.h"
+
+
+using namespace lair;
+
+
+LaneStats::LaneStats()
+    : _textMoba(nullptr)
+{
+	std::memset(_lanes, 0, sizeof(_lanes));
+}
+
+
+void LaneStats::initialize(TextMoba* textMoba) {
+	_textMoba = textMoba;
+
+	_nodes.assign(textMoba->_nodeList.size(), Stats());
+	std::memset(_nodes.data(), 0, _nodes.size() * sizeof(Stats));
+	std::memset(_lanes, 0, sizeof(_lanes));
+
+	MapNodeSP blueFonxus = textMoba->fonxus(BLUE);
+	for(Lane lane: { TOP, BOT }) {
+		std::vector<MapNode*>& nodes = _laneNodes[lane];
+		nodes.clear();
+		for(const MapNodeSP& node: textMoba->_nodeList) {
+			if(node->_lane == lane)
+				nodes.push_back(node.get());
+		}
+		if(blueFonxus) {
+			std::stable_sort(nodes.begin(), nodes.end(),
+			                 [textMoba, &blueFonxus](MapNode* n0, MapNode* n1) {
+				return textMoba->distance(BLUE, blueFonxus, n0->shared_from_this())
+				     < textMoba->distance(BLUE, blueFonxus, n1->shared_from_this());
+			});
+		}
+	}
+
+	unsigned count = textMoba->_nodeList.size();
+	for(Team team: { BLUE, RED }) {
+		for(Lane lane: { TOP, BOT }) {
+			std::vector<uint16>&   dist  = _laneDistance[team][lane];
+			std::vector<MapNode*>& rally = _rally[team][lane];
+			dist.assign(count, TextMoba::NO_PATH);
+			rally.assign(count, nullptr);
+			for(unsigned i = 0; i < count; ++i) {
+				MapNodeSP from = textMoba->_nodeList[i];
+				for(MapNode* node: _laneNodes[lane]) {
+					unsigned d = textMoba->distance(team, from, node->shared_from_this());
+					if(d < dist[i] || (d == dist[i] && rally[i] && node->_index < rally[i]->_index)) {
+						dist[i]  = d;
+						rally[i] = node;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+const LaneStats::Stats& LaneStats::node(const MapNode* node) const {
+	return _nodes[node->_index];
+}
+
+
+const LaneStats::Stats& LaneStats::lane(Lane lane) const {
+	return _lanes[lane];
+}
+
+
+const LaneStats::TeamStats& LaneStats::lane(Lane lane, Team team) const {
+	return _lanes[lane].teams[team];
+}
+
+
+const std::vector<MapNode*>& LaneStats::laneNodes(Lane lane) const {
+	return _laneNodes[lane];
+}
+
+
+unsigned LaneStats::laneDistance(Team team, Lane lane, const MapNode* node) const {
+	return _laneDistance[team][lane][node->_index];
+}
+
+
+MapNode* LaneStats::rally(Team team, Lane lane, const MapNode* node) const {
+	return _rally[team][lane][node->_index];
+}
+
+
+int LaneStats::front(Lane lane, Team team) const {
+	MapNode* node = frontNode(lane, team);
+	if(!node)
+		return NO_FRONT;
+	return _textMoba->distance(team, _textMoba->fonxus(team), node->shared_from_this());
+}
+
+
+MapNode* LaneStats::frontNode(Lane lane, Team team) const {
+	const std::vector<MapNode*>& nodes = _laneNodes[lane];
+	// Blue pushes toward the end of the list, red toward the beginning.
+	for(unsigned i = 0; i < nodes.size(); ++i) {
+		MapNode* node = nodes[(team == BLUE)? nodes.size() - i - 1: i];
+		if(_nodes[node->_index].teams[team].redshirts)
+			return node;
+	}
+	return nullptr;
+}
+
+
+int LaneStats::pressure(Lane lane, Team team) const {
+	const TeamStats& allies  = _lanes[lane].teams[team];
+	const TeamStats& enemies = _lanes[lane].teams[enemyTeam(team)];
+	return int(enemies.redshirtHp + enemies.heroHp)
+	     - int(allies.redshirtHp + allies.heroHp);
+}
+
+
+Lane LaneStats::neediestLane(Team team) const {
+	return (pressure(BOT, team) > pressure(TOP, team))? BOT: TOP;
+}
+
+
+void LaneStats::_update(const Character& character, int sign) {
+	MapNode* node = character.node().get();
+	Team team = character.team();
+	if(!node || team > RED || _nodes.empty())
+		return;
+
+	TeamStats* stats[2] = {
+	    &_nodes[node->_index].teams[team],
+	    (node->_lane != NO_LANE)? &_lanes[node->_lane].teams[team]: nullptr,
+	};
+	for(TeamStats* s: stats) {
+		if(!s)
+			continue;
+		switch(character.type()) {
+		case HERO:
+			s->heroes += sign;
+			s->heroHp += sign * int(character.hp());
+			break;
+		case REDSHIRT:
+			s->redshirts  += sign;
+			s->redshirtHp += sign * int(character.hp());
+			break;
+		case BUILDING:
+			if(character.className() == "tower")
+				s->towers += sign;
+			break;
+		}
+	}
+}
+
+
+void LaneStats::_updateHp(const Character& character, int delta) {
+	MapNode* node = character.node().get();
+	Team team = character.team();
+	if(!node || team > RED || _nodes.empty())
+		return;
+
+	TeamStats* stats[2] = {
+	    &_nodes[node->_index].teams[team],
+	    (node->_lane != NO_LANE)? &_lanes[node->_lane].teams[team]: nullptr,
+	};
+	for(TeamStats* s: stats) {
+		if(!s)
+			continue;
+		if(character.type() == HERO)
+			s->heroHp += delta;
+		else if(character.type() == REDSHIRT)
+			s->redshirtHp += delta;
+	}
+}
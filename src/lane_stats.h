@@ -0,0 +1,98 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_LANE_STATS_H_
+#define LD41_LANE_STATS_H_
+
+
+#include <lair/core/lair.h>
+
+#include "text_moba.h"
+
+
+// Per-node and per-lane aggregates of the characters, for the AIs and the
+// lanes command. Like the state hash, they are updated by the Character
+// setters, so keeping them up to date costs O(1) per change.
+class LaneStats {
+public:
+	struct TeamStats {
+		unsigned redshirts;
+		unsigned redshirtHp;
+		unsigned heroes;
+		unsigned heroHp;
+		unsigned towers;
+	};
+
+	struct Stats {
+		TeamStats teams[2];
+	};
+
+	enum {
+		NO_LANE  = -1,
+		NO_FRONT = -1,
+	};
+
+public:
+	LaneStats();
+
+	// Assigns the lanes to the nodes. Must be called after the paths are
+	// computed and while there is no characters in the game.
+	void initialize(TextMoba* textMoba);
+
+	const Stats& node(const MapNode* node) const;
+	const Stats& lane(Lane lane) const;
+	const TeamStats& lane(Lane lane, Team team) const;
+
+	// Lane nodes, from the blue fonxus side to the red one.
+	const std::vector<MapNode*>& laneNodes(Lane lane) const;
+
+	// Closest node of the lane from node for team, and its distance. Ties
+	// go to the lowest node index.
+	unsigned laneDistance(Team team, Lane lane, const MapNode* node) const;
+	MapNode* rally(Team team, Lane lane, const MapNode* node) const;
+
+	// Distance from the team fonxus of its furthest redshirt on the lane, or
+	// NO_FRONT if it has none. Scans the lane nodes, which are few.
+	int front(Lane lane, Team team) const;
+	MapNode* frontNode(Lane lane, Team team) const;
+
+	// How much the lane needs help from the heroes of team: enemy hp minus
+	// allied hp. Used to pick the hero lanes.
+	int pressure(Lane lane, Team team) const;
+	Lane neediestLane(Team team) const;
+
+	// Adds (sign = 1) or removes (sign = -1) the contribution of a
+	// character.
+	void _update(const Character& character, int sign);
+	void _updateHp(const Character& character, int delta);
+
+public:
+	TextMoba*             _textMoba;
+	std::vector<Stats>    _nodes;
+	Stats                 _lanes[2];
+	std::vector<MapNode*> _laneNodes[2];
+	// Indexed by [team][lane][MapNode::_index].
+	std::vector<lair::uint16> _laneDistance[2][2];
+	std::vector<MapNode*>     _rally[2][2];
+};
+
+
+#endif
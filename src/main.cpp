@@ -24,14 +24,50 @@
 #include "game.h"
 #include "splash_state.h"
 #include "main_state.h"
+#include "headless.h"
 
 
 int main(int argc, char** argv) {
+	if(isHeadless(argc, argv))
+		return runHeadless(argc, argv);
+
+	// Strip our own options before lair parses the command line.
+	String   recordPath;
+	unsigned maxFps     = FRAMES_PER_SEC;
+	bool     continuous = false;
+	for(int i = 1; i < argc; ) {
+		String arg = argv[i];
+		int used = 0;
+		if(arg == "--record" && i + 1 < argc) {
+			recordPath = argv[i + 1];
+			used = 2;
+		}
+		else if(arg == "--max-fps" && i + 1 < argc) {
+			maxFps = std::atoi(argv[i + 1]);
+			used = 2;
+		}
+		else if(arg == "--continuous") {
+			continuous = true;
+			used = 1;
+		}
+
+		if(!used) {
+			++i;
+			continue;
+		}
+		for(int j = i + used; j <= argc; ++j)
+			argv[j - used] = argv[j];
+		argc -= used;
+	}
+
 	Game game(argc, argv);
 	game.initialize();
 
-//	game.setNextState(game.splashState());
-	game.setNextState(game.mainState());
+	game.mainState()->setFrameRate(maxFps, continuous);
+	if(!recordPath.empty())
+		game.mainState()->startRecording(recordPath);
+
+	game.setNextState(game.splashState());
 	game.run();
 
 	game.shutdown();
@@ -19,8 +19,13 @@
  */
 
 
+#include <algorithm>
 #include <functional>
+#include <cstring>
 #include <iomanip>
+#include <iostream>
+
+#include <SDL.h>
 
 #include <lair/core/json.h>
 
@@ -70,6 +75,9 @@ MainState::MainState(Game* game)
 
       _console(),
       _consoleView(&_console, 60, 36),
+      _consoleGeneration(0),
+      _consoleCursor(-2, -2),
+      _statsShown(false),
 
       _camera(),
 
@@ -78,6 +86,10 @@ MainState::MainState(Game* game)
       _loop(sys()),
       _fpsTime(0),
       _fpsCount(0),
+      _continuous(false),
+      _redraw(true),
+      _frameCount(0),
+      _idleCount(0),
 
       _quitInput(nullptr),
       _leftInput(nullptr),
@@ -86,7 +98,13 @@ MainState::MainState(Game* game)
       _upInput(nullptr),
       _okInput(nullptr),
 
-      _textMoba(this, &_console)
+      _asyncLog(&std::clog),
+      _textMoba(this, &_console),
+      _replayRecorder(&_textMoba),
+      _simThread(&_textMoba),
+      _simEvent(0),
+      _loadStep(LOAD_ENTITIES),
+      _iconStamp(0)
 {
 	_entities.registerComponentManager(&_sprites);
 	_entities.registerComponentManager(&_collisions);
@@ -102,21 +120,21 @@ MainState::~MainState() {
 void MainState::initialize() {
 	using namespace std::placeholders;
 
-	srand(time(nullptr));
+	_textMoba.seed(time(nullptr));
 
 	_loop.reset();
 	_loop.setTickDuration(    ONE_SEC /  TICKS_PER_SEC);
-//	_loop.setFrameDuration(   ONE_SEC /  FRAMES_PER_SEC);
-	_loop.setFrameDuration(   0);
-	_loop.setMaxFrameDuration(_loop.frameDuration() * 3);
-	_loop.setFrameMargin(     _loop.frameDuration() / 2);
+	setFrameRate(FRAMES_PER_SEC, false);
 
 	window()->onResize.connect(std::bind(&MainState::resizeEvent, this))
 	        .track(_slotTracker);
 
 	game()->sys()->onKeyDown   = std::bind(&MainState::keyDown, this, _1, _2, _3, _4, _5);
 	game()->sys()->onKeyUp     = std::bind(&MainState::keyUp,   this, _1, _2, _3, _4, _5);
-	game()->sys()->onTextInput = std::bind(&Console::inputText, &_console, _1);
+	game()->sys()->onTextInput = [this](const String& text) {
+		_console.inputText(text);
+		requestRedraw();
+	};
 
 	_quitInput  = _inputs.addInput("quit");
 	_leftInput  = _inputs.addInput("left");
@@ -134,39 +152,153 @@ void MainState::initialize() {
 	_inputs.mapScanCode(_okInput,    SDL_SCANCODE_RETURN);
 	_inputs.mapScanCode(_okInput,    SDL_SCANCODE_RETURN2);
 
-	loadEntities("entities.ldl", _entities.root());
+	_simEvent = SDL_RegisterEvents(1);
+	_simThread.onPublish = [this]() {
+		SDL_Event event;
+		std::memset(&event, 0, sizeof(event));
+		event.type = _simEvent;
+		SDL_PushEvent(&event);
+	};
+
+	// Set to true to debug OpenGL calls
+//	renderer()->context()->setLogCalls(true);
+}
 
-	_models       = _entities.findByName("__models__");
-	_charModel    = _entities.findByName("char");
-	_mapIconModel = _entities.findByName("map_icon", _models);
 
-	_scene        = _entities.findByName("scene");
-	_view         = _entities.findByName("fp_view");
-	_map          = _entities.findByName("map");
-	_statsText    = _entities.findByName("stats_text");
-	_text         = _entities.findByName("text");
-	_cursor       = _entities.findByName("cursor");
+bool MainState::loadStep() {
+	switch(_loadStep) {
+	case LOAD_ENTITIES:
+		loadAtlas("sprites.ldl");
+		loadEntities("entities.ldl", _entities.root());
+
+		_models       = _entities.findByName("__models__");
+		_charModel    = _entities.findByName("char");
+		_mapIconModel = _entities.findByName("map_icon", _models);
+
+		_scene        = _entities.findByName("scene");
+		_view         = _entities.findByName("fp_view");
+		_map          = _entities.findByName("map");
+		_statsText    = _entities.findByName("stats_text");
+		_text         = _entities.findByName("text");
+		_cursor       = _entities.findByName("cursor");
+
+		// The sprites of entities.ldl use the atlas texture, select their
+		// part of it.
+		_atlas.setImage(_sprites.get(_charModel), "ranger.png");
+		_atlas.setImage(_sprites.get(_mapIconModel), "map_icons.png");
+		_atlas.setImage(_sprites.get(_view), "white.png");
+		_atlas.setImage(_sprites.get(_map), "map.png");
+		_atlas.setImage(_sprites.get(_entities.findByName("stats_bg")), "white.png");
+		_atlas.setImage(_sprites.get(_entities.findByName("text_bg")), "white.png");
+		_atlas.setImage(_sprites.get(_cursor), "white.png");
 
 //	loadSound("kittendeath.wav");
 
 //	loadMusic("ending.mp3");
 
 //	AssetSP font = loader()->loadAsset<BitmapFontLoader>("droid_sans_24.json");
+		break;
 
-	_textMoba.initialize("gameplay.ldl");
+	case LOAD_GAME:
+		// Game logs are written by a background thread.
+		_asyncLog.start();
+		_textMoba.setAsyncLog(&_asyncLog);
+		_textMoba.removeMessageSink(&_textMoba.logSink());
 
-	loader()->waitAll();
+		_textMoba.initialize("gameplay.ldl");
+
+		// Commands typed in the console are played by the simulation thread.
+		_console.setExecCommand([this](const String& command) {
+			if(!_simThread.post(command))
+				_console.writeLine("Too many commands pending, ignored.");
+		});
+		break;
+
+	case LOAD_FIRST_IMAGES: {
+		// Only wait for what is on screen when the game starts: the assets
+		// of entities.ldl and the node where the player is.
+		CharacterSP player = _textMoba.player();
+		if(player && player->node()) {
+			for(const String& image: player->node()->_images)
+				loader()->load<ImageLoader>(_atlas.texture(image));
+		}
+		loader()->waitAll();
+		break;
+	}
+
+	case LOAD_OTHER_IMAGES:
+		// The rest is loaded in the background while the game runs. If an
+		// image is needed before, it is loaded on demand.
+		loadImages();
+		_initialized = true;
+		break;
+	}
+
+	_loadStep += 1;
+	return _initialized;
+}
+
+
+void MainState::loadImages() {
+	// The classes first, as enemies can show up anywhere, then the nodes
+	// from the closest to the player to the furthest.
+	for(const String& image: _textMoba.classImages())
+		loadImage(_atlas.texture(image));
+
+	CharacterSP player = _textMoba.player();
+	if(!player || !player->node())
+		return;
+
+	std::vector<MapNode*> nodes;
+	std::unordered_set<MapNode*> queued;
+	nodes.push_back(player->node().get());
+	queued.insert(nodes.back());
+	for(unsigned i = 0; i < nodes.size(); ++i) {
+		MapNode* node = nodes[i];
+		if(i) {
+			for(const String& image: node->_images)
+				loadImage(_atlas.texture(image));
+		}
+
+		for(const auto& path: node->paths()) {
+			if(queued.insert(path.first).second)
+				nodes.push_back(path.first);
+		}
+	}
+}
+
+
+void MainState::loadImage(const String& path) {
+	loader()->load<ImageLoader>(path);
+	if(std::find(_pendingImages.begin(), _pendingImages.end(), path) == _pendingImages.end())
+		_pendingImages.push_back(path);
+}
 
-	// Set to true to debug OpenGL calls
-//	renderer()->context()->setLogCalls(true);
 
-	_initialized = true;
+bool MainState::updatePendingImages() {
+	auto loaded = [this](const String& path) {
+		AssetSP asset = assets()->getAsset(path);
+		auto image = asset? asset->aspect<ImageAspect>(): nullptr;
+		return !image || image->isValid();
+	};
+
+	auto end = std::remove_if(_pendingImages.begin(), _pendingImages.end(), loaded);
+	bool changed = end != _pendingImages.end();
+	_pendingImages.erase(end, _pendingImages.end());
+	return changed;
 }
 
 
 void MainState::shutdown() {
 	_slotTracker.disconnectAll();
 
+	_simThread.stop();
+	_replayRecorder.close();
+
+	_textMoba.setAsyncLog(nullptr);
+	_textMoba.addMessageSink(&_textMoba.logSink());
+	_asyncLog.stop();
+
 	_initialized = false;
 }
 
@@ -181,6 +313,10 @@ void MainState::run() {
 	_fpsCount = 0;
 
 	startGame();
+	// Like in headless mode, the replay starts once the game is loaded.
+	if(!_recordPath.empty() && !_replayRecorder.isOpen())
+		_replayRecorder.open(_recordPath);
+	_simThread.start(std::bind(&MainState::buildViewModel, this, std::placeholders::_1));
 
 	do {
 		switch(_loop.nextEvent()) {
@@ -188,12 +324,16 @@ void MainState::run() {
 			updateTick();
 			break;
 		case InterpLoop::Frame:
-			updateFrame();
+			if(_continuous || _redraw)
+				updateFrame();
+			else
+				waitForEvents();
 			break;
 		}
 	} while (_running);
 	_loop.stop();
 
+	_simThread.stop();
 	stopGame();
 }
 
@@ -208,35 +348,277 @@ Game* MainState::game() {
 }
 
 
-void MainState::addMapIcon(CharacterSP character) {
-	if(!character->isAlive() || !character->node())
-		return;
+void MainState::setFrameRate(unsigned maxFps, bool continuous) {
+	_continuous = continuous;
+	_loop.setFrameDuration(   maxFps? ONE_SEC / maxFps: 0);
+	_loop.setMaxFrameDuration(_loop.frameDuration() * 3);
+	_loop.setFrameMargin(     _loop.frameDuration() / 2);
+}
+
 
-	unsigned index = 5;
+void MainState::requestRedraw() {
+	_redraw = true;
+}
+
+
+void MainState::waitForEvents() {
+	// Block instead of spinning. The event stays in the SDL queue and is
+	// dispatched as usual on the next tick.
+	// While images load in the background, wake up every tick to show
+	// them as soon as they are ready.
+	int timeout = _pendingImages.empty()? IDLE_WAIT_MS: 1000 / TICKS_PER_SEC;
+	if(SDL_WaitEventTimeout(nullptr, timeout))
+		_redraw = true;
+	_idleCount += 1;
+
+	// Skip the ticks we slept through.
+	_loop.start();
+}
+
+
+static int mapIconIndex(CharacterSP character) {
 	if(character->type() == REDSHIRT)
-		index = 4;
+		return 4;
 	else if(character->cClass()->id() == "tower")
-		index = 3;
+		return 3;
 	else if(character->cClass()->id() == "ranger")
-		index = 0;
+		return 0;
 	else if(character->cClass()->id() == "warrior")
-		index = 1;
+		return 1;
 	else if(character->cClass()->id() == "mage")
-		index = 2;
+		return 2;
+	return -1;
+}
+
+
+String hpDesc(CharacterSP c) {
+	if(c->isAlive())
+		return cat(std::setw(6), c->hp(), " / ", c->maxHP());
+	return cat("  DEAD (", c->deathTime(), "t)");
+}
+
+String skillDesc(CharacterSP c) {
+	std::ostringstream out;
+	for(SkillSP skill: c->skills()) {
+		out << skill->name() << " " << skill->manaCost() << "mp";
+		if(skill->timeBeforeNextUse())
+			out << " (" << skill->timeBeforeNextUse() << "t)";
+		out << "\n";
+	}
+	return out.str();
+}
+
+String alliesDesc(const CharacterSet& chars) {
+	std::ostringstream out;
+	for(CharacterSP c: chars) {
+		if(c->type() != HERO || c->team() != BLUE || c->isPlayer())
+			continue;
+
+		out << c->className() << " lvl " << c->level() + 1 << "\n"
+		    << " hp:" << hpDesc(c) << "\n"
+		    << " mana:" << std::setw(4) << c->mana() << " / " << c->maxMana() << "\n";
+	}
+	return out.str();
+}
+
+static void writeStats(String& out, const TextMoba& textMoba, CharacterSP player) {
+	out.append(cat(
+	    "lvl ", player->level() + 1, " ", player->teamName(), " ", player->className(), "\n",
+	    " hp:", hpDesc(player), "\n",
+	    " mana:", std::setw(4), player->mana(), " / ", player->maxMana(), "\n",
+	    " xp:", std::setw(6), player->xp(),   " / ", textMoba.nextLevel(player), "\n",
+	    "\n",
+	    "Skills:\n",
+	    skillDesc(player),
+	    "\n",
+	    alliesDesc(textMoba.characters())
+	));
+}
+
+
+
+void MainState::buildViewModel(ViewModel& model) {
+	CharacterSP player = _textMoba.player();
+
+	model.stats.clear();
+	if(player) {
+		writeStats(model.stats, _textMoba, player);
+	}
+
+	model.icons.clear();
+	for(CharacterSP c: _textMoba.characters()) {
+		MapNode* node = c->isAlive()? c->node().get(): nullptr;
+		int tile = mapIconIndex(c);
+		if(node && tile >= 0)
+			model.icons.push_back(ViewModel::Icon{ c->index(), node, tile, c->team() });
+	}
+
+	bool visible = player && player->isAlive() && player->node();
+	model.viewImage.clear();
+	model.viewChars.clear();
+	if(visible) {
+		model.viewImage = player->node()->image();
+		for(CharacterSP c: player->node()->characters()) {
+			if(c->team() == RED && c->type() != BUILDING) {
+				model.viewChars.push_back(ViewModel::ViewChar{ c->cClass()->image(), c->place() });
+			}
+		}
+	}
+}
+
+
+void MainState::pollSimulation() {
+	String output;
+	while(_simThread.popOutput(output)) {
+		_console.writeLine(output);
+		requestRedraw();
+	}
+
+	const ViewModel* model = _simThread.acquire();
+	if(model) {
+		applyViewModel(*model);
+		requestRedraw();
+	}
+}
+
+
+void MainState::applyViewModel(const ViewModel& model) {
+	// Until the first update, the entity shows its placeholder text.
+	BitmapTextComponent* statsText = _texts.get(_statsText);
+	if(statsText && (model.stats != _stats || !_statsShown)) {
+		_stats = model.stats;
+		statsText->setText(_stats);
+		_statsShown = true;
+	}
+
+	_iconStamp += 1;
+	for(const ViewModel::Icon& icon: model.icons) {
+		updateMapIcon(icon);
+	}
+	for(auto icon = _mapIcons.begin(); icon != _mapIcons.end(); ) {
+		if(icon->second.stamp != _iconStamp)
+			icon = releaseMapIcon(icon);
+		else
+			++icon;
+	}
+
+	for(MapNode* node: _dirtyNodes) {
+		layoutMapIcons(model, node);
+	}
+	_dirtyNodes.clear();
 
-	if(index == 5)
+	updateView(model);
+}
+
+
+void MainState::updateMapIcon(const ViewModel::Icon& icon) {
+	auto it = _mapIcons.find(icon.character);
+	if(it == _mapIcons.end()) {
+		EntityRef e;
+		if(_mapIconPool.empty()) {
+			e = _entities.cloneEntity(_mapIconModel, _map);
+		}
+		else {
+			e = _mapIconPool.back();
+			_mapIconPool.pop_back();
+			e.setEnabled(true);
+		}
+
+		// Invalid tile and team, so that the sprite is set up below.
+		it = _mapIcons.emplace(icon.character, MapIcon{ e, nullptr, -1, NEUTRAL, 0 }).first;
+	}
+
+	MapIcon& mapIcon = it->second;
+	mapIcon.stamp = _iconStamp;
+
+	// Character indices are reused after a restart.
+	if(mapIcon.tile != icon.tile || mapIcon.team != icon.team) {
+		SpriteComponent* s = _sprites.get(mapIcon.entity);
+		s->setTileIndex(icon.tile);
+		s->setColor((icon.team == BLUE)?
+		                Vector4(.2, .2, .8, 1):
+		                Vector4(.8, .2, .2, 1));
+		mapIcon.tile = icon.tile;
+		mapIcon.team = icon.team;
+	}
+
+	if(mapIcon.node != icon.node) {
+		if(mapIcon.node)
+			_dirtyNodes.insert(mapIcon.node);
+		_dirtyNodes.insert(icon.node);
+		mapIcon.node = icon.node;
+	}
+}
+
+
+MapIconMap::iterator MainState::releaseMapIcon(MapIconMap::iterator icon) {
+	if(icon->second.node)
+		_dirtyNodes.insert(icon->second.node);
+
+	icon->second.entity.setEnabled(false);
+	_mapIconPool.push_back(icon->second.entity);
+	return _mapIcons.erase(icon);
+}
+
+
+void MainState::layoutMapIcons(const ViewModel& model, MapNode* node) {
+	EntityVector entities;
+	for(const ViewModel::Icon& icon: model.icons) {
+		if(icon.node != node)
+			continue;
+		auto it = _mapIcons.find(icon.character);
+		if(it != _mapIcons.end())
+			entities.push_back(it->second.entity);
+	}
+
+	if(entities.empty())
 		return;
 
-	EntityRef e = _entities.cloneEntity(_mapIconModel, _map);
-	e.placeAt(character->node()->pos());
+	const float offset = 16;
+	int width = std::ceil(std::sqrt(entities.size()));
+	int height = (entities.size() - 1) / width + 1;
+	Vector2 base = node->pos() - Vector2(width - 1, -height + 1) * offset / 2;
+
+	int i = 0;
+	for(EntityRef e: entities) {
+		e.placeAt(Vector2(base + Vector2(i % width, -i / width) * offset));
+		e.computeWorldTransform();
+		i += 1;
+	}
+}
+
+
+void MainState::updateView(const ViewModel& model) {
+	SpriteComponent* view = _sprites.get(_view);
+	view->setEnabled(!model.viewImage.empty());
+	if(!model.viewImage.empty()) {
+		_atlas.setImage(view, model.viewImage);
+	}
+
+	const ViewModel::ViewCharVector& viewChars = model.viewChars;
+	while(_viewChars.size() < viewChars.size()) {
+		_viewChars.push_back(_entities.cloneEntity(_charModel, _view));
+	}
+
+	const float margin = 120;
+	for(unsigned index = 0; index < _viewChars.size(); ++index) {
+		EntityRef e = _viewChars[index];
+		e.setEnabled(index < viewChars.size());
+		if(index >= viewChars.size())
+			continue;
+
+		const ViewModel::ViewChar& c = viewChars[index];
+		float x = 960 / 2;
+		if(viewChars.size() > 1) {
+			x = margin
+			  + index / float(viewChars.size() - 1) * (960 - 2 * margin);
+		}
 
-	SpriteComponent* s = _sprites.get(e);
-	s->setTileIndex(index);
-	s->setColor((character->team() == BLUE)?
-	                Vector4(.2, .2, .8, 1):
-	                Vector4(.8, .2, .2, 1));
+		e.placeAt(Vector2(x, (c.place == BACK)? 60: 30));
+		e.computeWorldTransform();
 
-	_mapCharMap[character->node().get()].push_back(e);
+		_atlas.setImage(_sprites.get(e), c.image);
+	}
 }
 
 
@@ -371,8 +753,15 @@ void MainState::stopGame() {
 }
 
 
+void MainState::startRecording(const String& path) {
+	_recordPath = path;
+}
+
+
 void MainState::keyDown(unsigned scancode, unsigned /*keycode*/, uint16 /*mod*/,
                         bool /*pressed*/, bool /*repeat*/) {
+	requestRedraw();
+
 	switch(scancode) {
 	case SDL_SCANCODE_RETURN:
 	case SDL_SCANCODE_RETURN2:
@@ -405,6 +794,10 @@ void MainState::keyUp(unsigned /*scancode*/, unsigned /*keycode*/, uint16 /*mod*
 
 void MainState::updateTick() {
 	loader()->finalizePending();
+	if(updatePendingImages())
+		requestRedraw();
+
+	pollSimulation();
 
 	_inputs.sync();
 
@@ -419,142 +812,33 @@ void MainState::updateTick() {
 }
 
 
-String hpDesc(CharacterSP c) {
-	if(c->isAlive())
-		return cat(std::setw(6), c->hp(), " / ", c->maxHP());
-	return cat("  DEAD (", c->deathTime(), "t)");
-}
-
-String skillDesc(CharacterSP c) {
-	std::ostringstream out;
-	for(SkillSP skill: c->skills()) {
-		out << skill->name() << " " << skill->manaCost() << "mp";
-		if(skill->timeBeforeNextUse())
-			out << " (" << skill->timeBeforeNextUse() << "t)";
-		out << "\n";
-	}
-	return out.str();
-}
-
-String alliesDesc(const CharacterSet& chars) {
-	std::ostringstream out;
-	for(CharacterSP c: chars) {
-		if(c->type() != HERO || c->team() != BLUE || c->isPlayer())
-			continue;
-
-		out << c->className() << " lvl " << c->level() + 1 << "\n"
-		    << " hp:" << hpDesc(c) << "\n"
-		    << " mana:" << std::setw(4) << c->mana() << " / " << c->maxMana() << "\n";
-	}
-	return out.str();
-}
-
 void MainState::updateFrame() {
 	// Update
 
 	BitmapTextComponent* text = _texts.get(_text);
 	if(text) {
-		Vector2i cursor(-1, -1);
-		text->setText(_consoleView.text(&cursor));
-
-		const BitmapFont& font = text->font()->get();
-
-		Vector3 pos(
-		    cursor(0) * font.glyph('m').advance,
-		    -cursor(1) * font.height() + 1020,
-		    0.1
-		);
-		_cursor.setEnabled(cursor(0) >= 0);
-		_cursor.placeAt(pos);
-		_cursor.computeWorldTransform();
-	}
-
-	CharacterSP player = _textMoba.player();
-	String stats;
-	if(player) {
-		stats = cat(
-		    "lvl ", player->level() + 1, " ", player->teamName(), " ", player->className(), "\n",
-		    " hp:", hpDesc(player), "\n",
-		    " mana:", std::setw(4), player->mana(), " / ", player->maxMana(), "\n",
-		    " xp:", std::setw(6), player->xp(),   " / ", _textMoba.nextLevel(player), "\n",
-		    "\n",
-		    "Skills:\n",
-		    skillDesc(player),
-		    "\n",
-		    alliesDesc(_textMoba.characters())
-		);
-	}
-	BitmapTextComponent* statsText = _texts.get(_statsText);
-	if(statsText) {
-		statsText->setText(stats);
-	}
-
-
-	SpriteComponent* view = _sprites.get(_view);
-	view->setEnabled(player && player->isAlive());
-	if(player && player->isAlive()) {
-		view->setTexture(player->node()->image());
-	}
-
-	while(_view.firstChild().isValid()) {
-		_view.firstChild().destroy();
-	}
-	if(player && player->isAlive() && player->node()) {
-		CharacterVector viewChars;
-		for(CharacterSP c: player->node()->characters()) {
-			if(c->team() == RED && c->type() != BUILDING) {
-				viewChars.push_back(c);
-			}
-		}
-		const float margin = 120;
-		unsigned index = 0;
-		for(CharacterSP c: viewChars) {
-			float x = 960 / 2;
-			if(viewChars.size() > 1) {
-				x = margin
-				  + index / float(viewChars.size() - 1) * (960 - 2 * margin);
-			}
-
-			EntityRef e = _entities.cloneEntity(_charModel, _view);
-			e.placeAt(Vector2(x, (c->place() == BACK)? 60: 30));
-			index += 1;
-
-			SpriteComponent* s = _sprites.get(e);
-			s->setTexture(c->cClass()->image());
-		}
-	}
-
-
-	_mapCharMap.clear();
-	while(_map.firstChild().isValid()) {
-		_map.firstChild().destroy();
-	}
-
-	if(player) {
-		for(CharacterSP c: _textMoba.characters()) {
-			addMapIcon(c);
+		// Setting the text re-lays it out, so only do it when it changed.
+		if(_consoleGeneration != _consoleView.generation()) {
+			text->setText(_consoleView.text());
+			_consoleGeneration = _consoleView.generation();
 		}
 
-		const float offset = 16;
-		for(const auto& pair: _mapCharMap) {
-			const EntityVector& entities = pair.second;
-
-			if(entities.size() < 2)
-				continue;
-
-			int width = std::ceil(std::sqrt(entities.size()));
-			int height = (entities.size() - 1) / width + 1;
-			Vector2 base = entities[0].position2() - Vector2(width - 1, -height + 1) * offset / 2;
-
-			int i = 0;
-			for(EntityRef e: entities) {
-				e.placeAt(Vector2(base + Vector2(i % width, -i / width) * offset));
-				i += 1;
-			}
+		Vector2i cursor = _consoleView.cursor();
+		if(cursor != _consoleCursor) {
+			const BitmapFont& font = text->font()->get();
+
+			Vector3 pos(
+			    cursor(0) * font.glyph('m').advance,
+			    -cursor(1) * font.height() + 1020,
+			    0.1
+			);
+			_cursor.setEnabled(cursor(0) >= 0);
+			_cursor.placeAt(pos);
+			_cursor.computeWorldTransform();
+			_consoleCursor = cursor;
 		}
 	}
 
-
 	// Rendering
 	Context* glc = renderer()->context();
 
@@ -591,11 +875,15 @@ void MainState::updateFrame() {
 	window()->swapBuffers();
 //	glc->setLogCalls(true);
 
+	_redraw = false;
+
 	int64 now = int64(sys()->getTimeNs());
 	++_fpsCount;
+	++_frameCount;
 	int64 etime = now - _fpsTime;
 	if(etime >= ONE_SEC) {
-		log().info("Fps: ", _fpsCount * float(ONE_SEC) / etime);
+		log().info("Fps: ", _fpsCount * float(ONE_SEC) / etime, " (", _frameCount,
+		           " frames drawn, ", _idleCount, " idle waits)");
 		_fpsTime  = now;
 		_fpsCount = 0;
 	}
@@ -603,6 +891,8 @@ void MainState::updateFrame() {
 
 
 void MainState::resizeEvent() {
+	requestRedraw();
+
 	Box3 viewBox(Vector3(0, 0, 0),
 	             Vector3(VIEW_WIDTH,
 	                     VIEW_HEIGHT, 1));
@@ -629,3 +919,17 @@ bool MainState::loadEntities(const Path& path, EntityRef parent, const Path& cd)
 
 	return success;
 }
+
+
+bool MainState::loadAtlas(const Path& path) {
+	log().info("Load atlas \"", path, "\"");
+
+	Path realPath = game()->dataPath() / path;
+	Path::IStream in(realPath.native().c_str());
+	if(!in.good()) {
+		log().error("Unable to read \"", path, "\".");
+		return false;
+	}
+
+	return _atlas.read(in, path);
+}
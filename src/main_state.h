@@ -23,6 +23,8 @@
 #define LD_41_MAIN_STATE_H_
 
 
+#include <unordered_set>
+
 #include <lair/core/signal.h>
 
 #include <lair/utils/game_state.h>
@@ -40,8 +42,11 @@
 #include <lair/ec/bitmap_text_component.h>
 #include <lair/ec/tile_layer_component.h>
 
+#include "atlas.h"
 #include "console.h"
 #include "text_moba.h"
+#include "replay.h"
+#include "sim_thread.h"
 
 
 using namespace lair;
@@ -50,9 +55,18 @@ using namespace lair;
 class Game;
 class MainState;
 
+enum LoadStep {
+	LOAD_ENTITIES,
+	LOAD_GAME,
+	LOAD_FIRST_IMAGES,
+	LOAD_OTHER_IMAGES,
+};
+
 enum {
 	TICKS_PER_SEC  = 60,
 	FRAMES_PER_SEC = 60,
+	// When there is nothing to draw, wake up at least this often.
+	IDLE_WAIT_MS   = 1000,
 	VIEW_WIDTH     = 1920,
 	VIEW_HEIGHT    = 1080,
 };
@@ -70,7 +84,19 @@ typedef std::deque<CommandExpr> CommandList;
 
 
 typedef std::vector<EntityRef> EntityVector;
-typedef std::unordered_map<MapNode*, EntityVector> MapCharMap;
+
+// The icon of a character alive on the map.
+struct MapIcon {
+	EntityRef entity;
+	MapNode*  node;
+	int       tile;
+	Team      team;
+	// Icons not seen in the last view model are released.
+	unsigned  stamp;
+};
+// Indexed by character index.
+typedef std::unordered_map<unsigned, MapIcon> MapIconMap;
+typedef std::unordered_set<MapNode*> MapNodeSet;
 
 
 class MainState : public GameState {
@@ -78,15 +104,43 @@ public:
 	MainState(Game* game);
 	virtual ~MainState();
 
+	// initialize() only sets up the state. The assets and the game are
+	// loaded by loadStep(), a bit at a time so that the splash screen
+	// keeps running. It returns true once the state can run.
 	virtual void initialize();
 	virtual void shutdown();
 
+	bool loadStep();
+	void loadImages();
+	// Queues an image to load in the background. The window is redrawn
+	// once it is ready.
+	void loadImage(const String& path);
+	// Forgets the queued images that are loaded, returns true if any.
+	bool updatePendingImages();
+
 	virtual void run();
 	virtual void quit();
 
 	Game* game();
 
-	void addMapIcon(CharacterSP character);
+	// By default, frames are only drawn when something changed (input, game
+	// state, window), at most maxFps per second (0: no cap). In continuous
+	// mode, every frame is drawn.
+	void setFrameRate(unsigned maxFps, bool continuous);
+	void requestRedraw();
+	void waitForEvents();
+
+	// The game runs on _simThread. buildViewModel() is called on that
+	// thread after each command, and the window only shows the last model
+	// it published. The map icon entities are pooled, not destroyed, and
+	// the layout is only updated where something changed.
+	void buildViewModel(ViewModel& model);
+	void pollSimulation();
+	void applyViewModel(const ViewModel& model);
+	void updateMapIcon(const ViewModel::Icon& icon);
+	MapIconMap::iterator releaseMapIcon(MapIconMap::iterator icon);
+	void layoutMapIcons(const ViewModel& model, MapNode* node);
+	void updateView(const ViewModel& model);
 
 	void exec(const std::string& cmd, EntityRef self = EntityRef());
 	void exec(const CommandList& commands);
@@ -104,6 +158,9 @@ public:
 	void startGame();
 	void stopGame();
 
+	// The recording starts with run(), once the game is loaded.
+	void startRecording(const String& path);
+
 	void keyDown(unsigned scancode, unsigned keycode, uint16 mod,
 	             bool pressed, bool repeat);
 	void keyUp(unsigned scancode, unsigned keycode, uint16 mod,
@@ -116,6 +173,7 @@ public:
 
 	bool loadEntities(const Path& path, EntityRef parent = EntityRef(),
 	                  const Path& cd = Path());
+	bool loadAtlas(const Path& path);
 
 public:
 	// More or less system stuff
@@ -135,6 +193,12 @@ public:
 
 	Console     _console;
 	ConsoleView _consoleView;
+	// State of the console the text and cursor entities were last updated for.
+	unsigned    _consoleGeneration;
+	Vector2i    _consoleCursor;
+	// Stats panel text, once it replaced the placeholder of entities.ldl.
+	bool        _statsShown;
+	String      _stats;
 
 	SlotTracker _slotTracker;
 
@@ -145,6 +209,10 @@ public:
 	InterpLoop  _loop;
 	int64       _fpsTime;
 	unsigned    _fpsCount;
+	bool        _continuous;
+	bool        _redraw;
+	uint64      _frameCount;
+	uint64      _idleCount;
 
 	CommandMap  _commands;
 	CommandList _commandList;
@@ -156,8 +224,21 @@ public:
 	Input*      _upInput;
 	Input*      _okInput;
 
+	Atlas       _atlas;
+	AsyncLog    _asyncLog;
 	TextMoba    _textMoba;
-	MapCharMap  _mapCharMap;
+	ReplayRecorder _replayRecorder;
+	String      _recordPath;
+	SimThread   _simThread;
+	// SDL event sent by _simThread to wake us up.
+	unsigned    _simEvent;
+	unsigned    _loadStep;
+	StringVector _pendingImages;
+	MapIconMap   _mapIcons;
+	EntityVector _mapIconPool;
+	unsigned     _iconStamp;
+	MapNodeSet   _dirtyNodes;
+	EntityVector _viewChars;
 
 	EntityRef   _models;
 	EntityRef   _charModel;
@@ -154,11 +154,11 @@ CharacterSP CharacterGroups::pick(Team team, Place place) const {
 	unsigned c = count(team, place);
 	if(c == 0)
 		return CharacterSP();
-	return get(team, place, rand() % c);
+	return get(team, place, _node->_textMoba->random(c));
 }
 
 
-CharacterSP CharacterGroups::pickClosestEnemy(CharacterSP c, int range) const {
+int CharacterGroups::closestEnemyRow(CharacterSP c, int range) const {
 	if(range < 0)
 		range = c->range();
 
@@ -170,16 +170,22 @@ CharacterSP CharacterGroups::pickClosestEnemy(CharacterSP c, int range) const {
 
 	if(count(enemy, FRONT)) {
 		if(range > 0) {
-			return pick(enemy, FRONT);
+			return FRONT;
 		}
 		range -= 1;
 	}
 
 	if(range > 0 && count(enemy, BACK)) {
-		return pick(enemy, BACK);
+		return BACK;
 	}
 
-	return CharacterSP();
+	return -1;
+}
+
+
+CharacterSP CharacterGroups::pickClosestEnemy(CharacterSP c, int range) const {
+	int row = closestEnemyRow(c, range);
+	return (row >= 0)? pick(c->enemyTeam(), Place(row)): CharacterSP();
 }
 
 
@@ -188,20 +194,23 @@ unsigned CharacterGroups::_index(unsigned team, unsigned place) const {
 }
 
 
-void CharacterGroups::dump() const {
-	dbgLogger.debug("Group:");
-	dbgLogger.debug("  Blue Back:");
+void CharacterGroups::dump(TextMoba* tm) const {
+	if(!tm->wants(MSG_DEBUG))
+		return;
+
+	tm->message(MSG_DEBUG, "Group:");
+	tm->message(MSG_DEBUG, "  Blue Back:");
 	for(unsigned i = 0; i < count(BLUE, BACK); ++i)
-		dbgLogger.debug("    ", get(BLUE, BACK, i)->debugName());
-	dbgLogger.debug("  Blue Front:");
+		tm->message(MSG_DEBUG, "    ", debugNameOf(get(BLUE, BACK, i)));
+	tm->message(MSG_DEBUG, "  Blue Front:");
 	for(unsigned i = 0; i < count(BLUE, FRONT); ++i)
-		dbgLogger.debug("    ", get(BLUE, FRONT, i)->debugName());
-	dbgLogger.debug("  Red Front:");
+		tm->message(MSG_DEBUG, "    ", debugNameOf(get(BLUE, FRONT, i)));
+	tm->message(MSG_DEBUG, "  Red Front:");
 	for(unsigned i = 0; i < count(RED, FRONT); ++i)
-		dbgLogger.debug("    ", get(RED, FRONT, i)->debugName());
-	dbgLogger.debug("  Red Back:");
+		tm->message(MSG_DEBUG, "    ", debugNameOf(get(RED, FRONT, i)));
+	tm->message(MSG_DEBUG, "  Red Back:");
 	for(unsigned i = 0; i < count(RED, BACK); ++i)
-		dbgLogger.debug("    ", get(RED, BACK, i)->debugName());
+		tm->message(MSG_DEBUG, "    ", debugNameOf(get(RED, BACK, i)));
 }
 
 
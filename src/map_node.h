@@ -44,11 +44,13 @@ public:
 	unsigned distanceBetween(CharacterSP c0, CharacterSP c1) const;
 
 	CharacterSP pick(Team team, Place place) const;
+	// The enemy row c attacks (see pickClosestEnemy()), or -1.
+	int closestEnemyRow(CharacterSP c, int range = -1) const;
 	CharacterSP pickClosestEnemy(CharacterSP c, int range = -1) const;
 
 	unsigned _index(unsigned team, unsigned place) const;
 
-	void dump() const;
+	void dump(TextMoba* tm) const;
 
 public:
 	const MapNode* _node;
@@ -84,13 +86,18 @@ public:
 	void removeCharacter(CharacterSP character);
 
 public:
+	TextMoba*     _textMoba;
+
 	lair::String  _id;
+	unsigned      _index;
 	lair::String  _name;
 	NodeMap       _paths;
 	StringVector  _images;
 	lair::Vector2 _pos;
 	lair::String  _tower;
 	lair::String  _fonxus;
+	// A Lane, or LaneStats::NO_LANE for the jungle, the river and the bases.
+	int           _lane;
 
 	CharacterSet  _characters;
 
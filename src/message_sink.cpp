@@ -0,0 +1,99 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/log.h>
+
+#include "console.h"
+
+#include "message_sink.h"
+
+
+using namespace lair;
+
+
+MessageSink::~MessageSink() {
+}
+
+
+
+ConsoleSink::ConsoleSink(Console* console)
+    : _console(console)
+{
+}
+
+
+MessageMask ConsoleSink::wantedMessages() const {
+	return messageBit(MSG_CONSOLE);
+}
+
+
+void ConsoleSink::write(MessageKind /*kind*/, const String& message) {
+	_console->writeLine(message);
+}
+
+
+
+LogSink::LogSink(MessageKind minLevel)
+    : _minLevel(minLevel)
+{
+}
+
+
+MessageKind LogSink::minLevel() const {
+	return _minLevel;
+}
+
+
+void LogSink::setMinLevel(MessageKind minLevel) {
+	_minLevel = minLevel;
+}
+
+
+MessageMask LogSink::wantedMessages() const {
+	MessageMask mask = 0;
+	for(unsigned kind = _minLevel; kind <= MSG_ERROR; ++kind)
+		mask |= messageBit(MessageKind(kind));
+	return mask;
+}
+
+
+void LogSink::write(MessageKind kind, const String& message) {
+	switch(kind) {
+	case MSG_DEBUG:
+		dbgLogger.debug(message);
+		break;
+	case MSG_INFO:
+		dbgLogger.info(message);
+		break;
+	case MSG_LOG:
+		dbgLogger.log(message);
+		break;
+	case MSG_WARNING:
+		dbgLogger.warning(message);
+		break;
+	case MSG_ERROR:
+		dbgLogger.error(message);
+		break;
+	case MSG_CONSOLE:
+	case MSG_KIND_COUNT:
+		break;
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_MESSAGE_SINK_H_
+#define LD41_MESSAGE_SINK_H_
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+
+class Console;
+
+
+enum MessageKind {
+	MSG_DEBUG,
+	MSG_INFO,
+	MSG_LOG,
+	MSG_WARNING,
+	MSG_ERROR,
+	MSG_CONSOLE,
+
+	MSG_KIND_COUNT,
+};
+
+// Messages below this level are stripped at compile time.
+#ifndef LD41_MIN_LOG_LEVEL
+#define LD41_MIN_LOG_LEVEL 0
+#endif
+
+typedef unsigned MessageMask;
+
+inline MessageMask messageBit(MessageKind kind) {
+	return 1u << kind;
+}
+
+
+// A consumer of TextMoba messages. Messages are only formatted if at least
+// one sink wants them.
+class MessageSink {
+public:
+	virtual ~MessageSink();
+
+	virtual MessageMask wantedMessages() const = 0;
+	virtual void write(MessageKind kind, const lair::String& message) = 0;
+};
+
+typedef std::vector<MessageSink*> MessageSinkVector;
+
+
+class ConsoleSink : public MessageSink {
+public:
+	ConsoleSink(Console* console);
+
+	virtual MessageMask wantedMessages() const override;
+	virtual void write(MessageKind kind, const lair::String& message) override;
+
+public:
+	Console* _console;
+};
+
+
+class LogSink : public MessageSink {
+public:
+	LogSink(MessageKind minLevel = MSG_DEBUG);
+
+	MessageKind minLevel() const;
+	void setMinLevel(MessageKind minLevel);
+
+	virtual MessageMask wantedMessages() const override;
+	virtual void write(MessageKind kind, const lair::String& message) override;
+
+public:
+	MessageKind _minLevel;
+};
+
+
+#endif
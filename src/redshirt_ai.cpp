@@ -24,6 +24,7 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "character.h"
+#include "binary_io.h"
 
 #include "redshirt_ai.h"
 
@@ -38,40 +39,30 @@ RedshirtAi::RedshirtAi(CharacterSP character, Lane lane)
 }
 
 
+AiType RedshirtAi::type() const {
+	return AI_REDSHIRT;
+}
+
+
 void RedshirtAi::play() {
 	CharacterSP c = character();
 
 	if(!c || !c->isAlive())
 		return;
 
-//	dbgLogger.log(c->debugName(), " turn:");
-
-	Team enemy = c->enemyTeam();
-
-	CharacterGroups groups = c->node()->characterGroups();
-	if(groups.count(enemy)) {
-		CharacterSP target = _target.lock();
-
-		if(!target || !target->isAlive() ||
-		        groups.distanceBetween(c, target) > c->range()) {
-			target = groups.pickClosestEnemy(c);
-		}
-
-		if(target) {
-			_target = target;
-//			dbgLogger.info("  Attack ", target->debugName());
-			c->attack(target);
-		}
-	}
-	else {
-		MapNodeSP dest = c->node()->destination((c->team() == BLUE)? "red": "blue");
-		if(!dest) {
-			dest = c->node()->destination((_lane == TOP)? "top": "bot");
-		}
-
-		if(dest) {
-//			dbgLogger.info("  Go to ", dest->name());
-			c->moveTo(dest);
-		}
-	}
+	AiAgent agent(c, &_target);
+	agent._lane = &_lane;
+	c->_textMoba->behaviorTrees().run(BT_REDSHIRT, agent);
+}
+
+
+void RedshirtAi::write(BinaryWriter& writer) const {
+	writer.writeUInt(_lane);
+	writeCharacterRef(writer, _target.lock());
+}
+
+
+void RedshirtAi::read(BinaryReader& reader, const CharacterIndexMap& characters) {
+	_lane   = Lane(reader.readUInt() & 0x01);
+	_target = readCharacterRef(reader, characters);
 }
@@ -32,8 +32,13 @@ class RedshirtAi : public Ai {
 public:
 	RedshirtAi(CharacterSP character, Lane lane);
 
+	virtual AiType type() const override;
+
 	virtual void play() override;
 
+	virtual void write(BinaryWriter& writer) const override;
+	virtual void read(BinaryReader& reader, const CharacterIndexMap& characters) override;
+
 public:
 	Lane        _lane;
 	CharacterWP _target;
@@ -0,0 +1,248 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cstring>
+#include <thread>
+
+#include <lair/core/log.h>
+
+#include "replay.h"
+
+
+using namespace lair;
+
+
+const char Replay::magic[8] = { 'l', 'd', '4', '1', 'r', 'p', 'l', '\n' };
+
+
+Replay::Replay()
+    : _flags(0)
+    , _rngState(0)
+{
+}
+
+
+bool Replay::read(std::istream& in, String* error) {
+	BinaryReader reader(&in);
+
+	auto fail = [error](const char* msg) {
+		if(error)
+			*error = msg;
+		return false;
+	};
+
+	char fileMagic[sizeof(magic)];
+	if(!reader.readBytes(fileMagic, sizeof(magic)) ||
+	   std::memcmp(fileMagic, magic, sizeof(magic)) != 0)
+		return fail("not a replay file");
+
+	if(reader.readUInt() != VERSION)
+		return fail("unsupported replay version");
+
+	_flags    = reader.readUInt();
+	_rngState = reader.readUInt();
+
+	_records.clear();
+	StringVector commands;
+	while(reader.good() && !reader.atEnd()) {
+		ReplayRecord record;
+		record.delay = reader.readUInt();
+
+		uint64 index = reader.readUInt();
+		if(index == 0) {
+			record.command = reader.readString();
+			commands.push_back(record.command);
+		}
+		else if(index <= commands.size()) {
+			record.command = commands[index - 1];
+		}
+		else {
+			reader.fail();
+		}
+
+		record.turnEnded = (_flags & HAS_HASHES) && reader.readBool();
+		record.turn      = record.turnEnded? reader.readUInt(): 0;
+		record.stateHash = record.turnEnded? reader.readUInt(): 0;
+
+		if(reader.good())
+			_records.push_back(record);
+	}
+
+	if(!reader.good())
+		return fail("truncated or corrupted replay");
+
+	return true;
+}
+
+
+uint64 Replay::duration() const {
+	uint64 duration = 0;
+	for(const ReplayRecord& record: _records)
+		duration += record.delay;
+	return duration;
+}
+
+
+
+ReplayRecorder::ReplayRecorder(TextMoba* textMoba)
+    : _textMoba(textMoba)
+    , _file()
+    , _writer(&_file)
+    , _recordHashes(false)
+    , _lastTurn(0)
+{
+}
+
+
+ReplayRecorder::~ReplayRecorder() {
+	close();
+}
+
+
+bool ReplayRecorder::open(const String& path, bool recordHashes) {
+	close();
+
+	_file.open(path.c_str(), std::ios_base::out | std::ios_base::binary
+	                                             | std::ios_base::trunc);
+	if(!_file.good()) {
+		dbgLogger.error("Unable to write replay \"", path, "\".");
+		return false;
+	}
+
+	_recordHashes = recordHashes;
+	_lastTime     = Clock::now();
+	_lastTurn     = _textMoba->_turn;
+	_commandIndices.clear();
+
+	_writer.writeBytes(Replay::magic, sizeof(Replay::magic));
+	_writer.writeUInt(Replay::VERSION);
+	_writer.writeUInt(recordHashes? Replay::HAS_HASHES: 0);
+	_writer.writeUInt(_textMoba->rngState());
+
+	_textMoba->setReplayRecorder(this);
+
+	return true;
+}
+
+
+void ReplayRecorder::close() {
+	if(!isOpen())
+		return;
+
+	if(_textMoba->replayRecorder() == this)
+		_textMoba->setReplayRecorder(nullptr);
+	_file.close();
+}
+
+
+bool ReplayRecorder::isOpen() const {
+	return _file.is_open();
+}
+
+
+void ReplayRecorder::recordCommand(const String& command) {
+	using namespace std::chrono;
+
+	Clock::time_point now = Clock::now();
+	_writer.writeUInt(duration_cast<milliseconds>(now - _lastTime).count());
+	_lastTime = now;
+
+	auto it = _commandIndices.find(command);
+	if(it != _commandIndices.end()) {
+		_writer.writeUInt(it->second);
+	}
+	else {
+		_writer.writeUInt(0);
+		_writer.writeString(command);
+		_commandIndices.emplace(command, _commandIndices.size() + 1);
+	}
+}
+
+
+void ReplayRecorder::endCommand() {
+	if(_recordHashes) {
+		unsigned turn = _textMoba->_turn;
+		bool turnEnded = (turn != _lastTurn);
+		_writer.writeBool(turnEnded);
+		if(turnEnded) {
+			_writer.writeUInt(turn);
+			_writer.writeUInt(_textMoba->stateHash());
+		}
+		_lastTurn = turn;
+	}
+
+	// A crash must not lose the commands that lead to it.
+	_file.flush();
+}
+
+
+
+bool playReplay(TextMoba* textMoba, const Replay& replay, bool verify,
+                bool realTime, std::ostream* report) {
+	textMoba->setRngState(replay._rngState);
+
+	if(verify && !(replay._flags & Replay::HAS_HASHES) && report) {
+		*report << "Replay has no state hashes, nothing to verify.\n";
+	}
+
+	unsigned nTurns = 0;
+	for(unsigned i = 0; i < replay._records.size(); ++i) {
+		const ReplayRecord& record = replay._records[i];
+
+		if(realTime) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(record.delay));
+		}
+
+		textMoba->_execCommand(record.command);
+
+		if(!record.turnEnded)
+			continue;
+		nTurns += 1;
+
+		if(verify) {
+			uint64 hash = textMoba->stateHash();
+			if(hash != textMoba->computeStateHash() && report) {
+				*report << "Incremental state hash is out of sync at turn "
+				        << textMoba->_turn << ".\n";
+			}
+			if(textMoba->_turn != record.turn || hash != record.stateHash) {
+				if(report) {
+					*report << "Replay diverged at command " << i
+					        << " (\"" << record.command << "\"), turn "
+					        << record.turn << ": expected hash "
+					        << std::hex << record.stateHash << ", got "
+					        << hash << " at turn " << std::dec
+					        << textMoba->_turn << ".\n";
+				}
+				return false;
+			}
+		}
+	}
+
+	if(report) {
+		*report << "Replay " << (verify? "verified": "done") << ": "
+		        << replay._records.size() << " commands, "
+		        << nTurns << " turns, "
+		        << replay.duration() / 1000 << "s recorded.\n";
+	}
+
+	return true;
+}
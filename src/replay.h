@@ -0,0 +1,116 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_REPLAY_H_
+#define LD41_REPLAY_H_
+
+
+#include <fstream>
+#include <chrono>
+
+#include <lair/core/lair.h>
+
+#include "binary_io.h"
+#include "text_moba.h"
+
+
+// A replay file contains the state of the random number generator when the
+// recording started followed by every command typed by the player with its
+// timing. As the game logic is deterministic, this is enough to replay it.
+//
+// Format: magic, then varints: version, flags, rng state. Each record is the
+// delay since the previous command in milliseconds, the command (an index in
+// the table of already seen commands, or 0 followed by a new string) and if
+// the file has hashes, a flag telling if a turn ended followed by the turn
+// number and state hash.
+
+struct ReplayRecord {
+	lair::uint64 delay;
+	lair::String command;
+	bool         turnEnded;
+	unsigned     turn;
+	lair::uint64 stateHash;
+};
+
+typedef std::vector<ReplayRecord> ReplayRecordVector;
+
+
+class Replay {
+public:
+	enum {
+		VERSION = 1,
+	};
+
+	enum Flags {
+		HAS_HASHES = 0x01,
+	};
+
+	static const char magic[8];
+
+public:
+	Replay();
+
+	bool read(std::istream& in, lair::String* error = nullptr);
+
+	lair::uint64 duration() const;
+
+public:
+	unsigned           _flags;
+	lair::uint64       _rngState;
+	ReplayRecordVector _records;
+};
+
+
+class ReplayRecorder {
+public:
+	ReplayRecorder(TextMoba* textMoba);
+	~ReplayRecorder();
+
+	bool open(const lair::String& path, bool recordHashes = true);
+	void close();
+	bool isOpen() const;
+
+	void recordCommand(const lair::String& command);
+	void endCommand();
+
+public:
+	typedef std::chrono::steady_clock Clock;
+	typedef std::unordered_map<lair::String, unsigned> CommandIndexMap;
+
+public:
+	TextMoba*         _textMoba;
+	std::ofstream     _file;
+	BinaryWriter      _writer;
+	bool              _recordHashes;
+	Clock::time_point _lastTime;
+	unsigned          _lastTurn;
+	CommandIndexMap   _commandIndices;
+};
+
+
+// Plays the records of replay on textMoba, that must be freshly initialized
+// with the same gameplay file. If verify is set, compares the state hashes
+// and stops at the first divergence. Returns false if the replay diverged.
+bool playReplay(TextMoba* textMoba, const Replay& replay, bool verify,
+                bool realTime = false, std::ostream* report = nullptr);
+
+
+#endif
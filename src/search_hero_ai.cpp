@@ -0,0 +1,500 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <cmath>
+#include <thread>
+
+#include <lair/core/log.h>
+
+#include "map_node.h"
+#include "character.h"
+#include "skill.h"
+#include "state_hash.h"
+#include "speculator.h"
+
+#include "search_hero_ai.h"
+
+
+using namespace lair;
+
+
+static const float EXPLORATION = 0.5f;
+
+
+HeroSearch::HeroSearch()
+    : _model(nullptr)
+    , _nextTurn(0)
+    , _playouts(0)
+    , _nodeCount(0)
+    , _time(0)
+    , _threadCount(0)
+{
+}
+
+
+bool HeroSearch::search(const SimModel& model, const SimState& root, unsigned hero,
+                        unsigned time, unsigned playouts, unsigned threadCount,
+                        const std::atomic<bool>* cancel, SimAction& action) {
+	_model = &model;
+	_root.copyFrom(root);
+
+	int slot = _root.slotOf(hero);
+	if(slot < 0)
+		return false;
+
+	// The player does not have an AI. Assume it behaves like a scripted hero,
+	// which is a better guess than an idle player.
+	int player = _root.slotOf(_root.player);
+	if(player >= 0 && _root.chars[player].ai == 0) {
+		_root.chars[player].ai       = AI_HERO + 1;
+		_root.chars[player].aiStatus = HeroAi::PUSH_LANE;
+		_root.chars[player].lane     = TOP;
+	}
+
+	model.actions(_root, slot, _actions);
+
+	bool reuse = _trees.size() == threadCount && _nextTurn == _root.turn;
+	_trees.resize(threadCount);
+	for(unsigned i = 0; i < threadCount; ++i) {
+		Tree& tree = _trees[i];
+		if(reuse)
+			_reuseTree(tree);
+		else
+			_resetTree(tree);
+		tree.rng = hashMix(_root.rng ^ (uint64(hero) << 32 | i));
+	}
+
+	Clock::time_point start    = Clock::now();
+	Clock::time_point deadline = start + std::chrono::milliseconds(time);
+
+	std::vector<std::thread> workers;
+	for(unsigned i = 1; i < threadCount; ++i) {
+		workers.emplace_back(&HeroSearch::_search, this, i, hero, deadline,
+		                     playouts, cancel);
+	}
+	_search(0, hero, deadline, playouts, cancel);
+	for(std::thread& worker: workers) {
+		worker.join();
+	}
+
+	// Merge the root statistics: children of the root are in the same order
+	// in all trees.
+	std::vector<unsigned> visits(_actions.size(), 0);
+	_playouts  = 0;
+	_nodeCount = 0;
+	for(const Tree& tree: _trees) {
+		_playouts  += tree.playouts;
+		_nodeCount += tree.nodes.size();
+		for(unsigned i = 0; i < _actions.size(); ++i) {
+			visits[i] += tree.nodes[1 + i].visits;
+		}
+	}
+
+	_time = std::chrono::duration_cast<std::chrono::microseconds>(
+	            Clock::now() - start).count();
+	_threadCount = threadCount;
+
+	if(_playouts == 0) {
+		reset();
+		return false;
+	}
+
+	unsigned best = 0;
+	for(unsigned i = 1; i < _actions.size(); ++i) {
+		if(visits[i] > visits[best])
+			best = i;
+	}
+
+	for(Tree& tree: _trees) {
+		tree.next = 1 + best;
+	}
+	_nextTurn = _root.turn + 1;
+
+	action = _actions[best];
+	return true;
+}
+
+
+void HeroSearch::reset() {
+	_nextTurn = 0;
+}
+
+
+void HeroSearch::_search(unsigned treeIndex, unsigned hero, Clock::time_point deadline,
+                         unsigned playouts, const std::atomic<bool>* cancel) {
+	Tree& tree = _trees[treeIndex];
+	Team  team = Team(_root.chars[_root.slotOf(hero)].team);
+
+	SimState state;
+	SimActionVector actions;
+	std::vector<unsigned> path;
+
+	tree.playouts = 0;
+	for(;;) {
+		if(playouts) {
+			if(tree.playouts == playouts)
+				break;
+		}
+		else if(tree.playouts % 8 == 0 && Clock::now() >= deadline) {
+			break;
+		}
+		if(cancel && *cancel)
+			break;
+
+		_playout(tree, hero, team, state, actions, path);
+		tree.playouts += 1;
+	}
+}
+
+
+void HeroSearch::_playout(Tree& tree, unsigned hero, Team team, SimState& state,
+                          SimActionVector& actions, std::vector<unsigned>& path) {
+	state.copyFrom(_root);
+	// Selection and expansion. The root is in the middle of a turn, the
+	// other nodes are between two turns.
+	unsigned node = 0;
+	path.clear();
+	path.push_back(node);
+	while(state.result == SIM_RUNNING) {
+		int slot = state.slotOf(hero);
+		if(slot < 0)
+			break;
+
+		if(tree.nodes[node].childCount == 0) {
+			if(tree.nodes.size() + SIM_MAX_CHARACTERS + 16 > MAX_NODES)
+				break;
+
+			_model->actions(state, slot, actions);
+			tree.nodes[node].firstChild = tree.nodes.size();
+			tree.nodes[node].childCount = actions.size();
+			for(const SimAction& action: actions) {
+				tree.nodes.push_back(Node{ action, 0, 0, 0, 0 });
+			}
+		}
+
+		unsigned child = _select(tree, node);
+		SimAction action = tree.nodes[child].action;
+		if(node == 0) {
+			_model->applyAction(state, slot, action);
+			_model->finishTurn(state, slot);
+		}
+		else {
+			state.chars[slot].action = action;
+			_model->nextTurn(state);
+
+			// Not consumed if the hero died before playing.
+			slot = state.slotOf(hero);
+			if(slot >= 0)
+				state.chars[slot].action.type = SIM_NONE;
+		}
+
+		node = child;
+		path.push_back(node);
+		if(tree.nodes[node].visits == 0)
+			break;
+	}
+
+	// Rollout, with the scripted behavior and a different luck each time.
+	tree.rng += 0x9e3779b97f4a7c15ull;
+	state.rng ^= hashMix(tree.rng);
+	for(unsigned i = 0; i < ROLLOUT_TURNS && state.result == SIM_RUNNING; ++i) {
+		_model->nextTurn(state);
+	}
+
+	float reward = _evaluate(state, team);
+	for(unsigned n: path) {
+		tree.nodes[n].visits += 1;
+		tree.nodes[n].value  += reward;
+	}
+}
+
+
+unsigned HeroSearch::_select(const Tree& tree, unsigned node) const {
+	const Node& parent = tree.nodes[node];
+	float logVisits = std::log(float(parent.visits + 1));
+
+	unsigned best      = parent.firstChild;
+	float    bestScore = -1;
+	for(unsigned i = parent.firstChild; i < parent.firstChild + parent.childCount; ++i) {
+		const Node& child = tree.nodes[i];
+		if(child.visits == 0)
+			return i;
+
+		float score = child.value / child.visits
+		            + EXPLORATION * std::sqrt(logVisits / child.visits);
+		if(score > bestScore) {
+			best      = i;
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+
+float HeroSearch::_evaluate(const SimState& state, Team team) const {
+	if(state.result == SIM_WIN)
+		return (team == BLUE)? 1: 0;
+	if(state.result == SIM_LOSS)
+		return (team == RED)? 1: 0;
+
+	float score = 0;
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.removed)
+			continue;
+
+		float hp    = float(c.hp) / float(_model->maxHP(c));
+		float worth = 0;
+		switch(c.type) {
+		case HERO: {
+			unsigned nextLevel = _model->nextLevel(c);
+			worth = 0.5f * (c.level + (nextLevel? float(c.xp) / nextLevel: 0));
+			if(!c.deathTime)
+				worth += 1 + hp;
+			break;
+		}
+		case REDSHIRT:
+			worth = 0.1f + 0.1f * hp;
+			break;
+		case BUILDING:
+			if(c.index == state.blueFonxus || c.index == state.redFonxus)
+				worth = 5 + 10 * hp;
+			else
+				worth = 3 + 2 * hp;
+			break;
+		}
+
+		score += (c.team == team)? worth: -worth;
+	}
+
+	return 1 / (1 + std::exp(-score / 4));
+}
+
+
+void HeroSearch::_resetTree(Tree& tree) {
+	tree.nodes.clear();
+	tree.nodes.push_back(Node{ SimAction{ SIM_NONE, 0, 0 }, 0, 0, 1, unsigned(_actions.size()) });
+	for(const SimAction& action: _actions) {
+		tree.nodes.push_back(Node{ action, 0, 0, 0, 0 });
+	}
+	tree.playouts = 0;
+	tree.next     = 0;
+}
+
+
+void HeroSearch::_reuseTree(Tree& tree) {
+	if(tree.next == 0 || tree.next >= tree.nodes.size()) {
+		_resetTree(tree);
+		return;
+	}
+
+	// The child played last turn becomes the root. Its children that are
+	// still valid keep their subtree.
+	const NodeVector& old = tree.nodes;
+	const Node& oldRoot = old[tree.next];
+
+	NodeVector nodes;
+	nodes.reserve(old.size());
+	nodes.push_back(Node{ oldRoot.action, oldRoot.visits, oldRoot.value,
+	                      1, unsigned(_actions.size()) });
+	for(const SimAction& action: _actions) {
+		nodes.push_back(Node{ action, 0, 0, 0, 0 });
+	}
+
+	for(unsigned i = 0; i < _actions.size(); ++i) {
+		for(unsigned j = oldRoot.firstChild; j < oldRoot.firstChild + oldRoot.childCount; ++j) {
+			if(old[j].action == _actions[i]) {
+				nodes[1 + i].visits = old[j].visits;
+				nodes[1 + i].value  = old[j].value;
+				_copyChildren(old, j, nodes, 1 + i);
+				break;
+			}
+		}
+	}
+
+	tree.nodes.swap(nodes);
+	tree.playouts = 0;
+	tree.next     = 0;
+}
+
+
+void HeroSearch::_copyChildren(const NodeVector& from, unsigned fromNode,
+                               NodeVector& to, unsigned toNode) {
+	const Node& node = from[fromNode];
+	if(node.childCount == 0)
+		return;
+
+	unsigned first = to.size();
+	to[toNode].firstChild = first;
+	to[toNode].childCount = node.childCount;
+	for(unsigned i = 0; i < node.childCount; ++i) {
+		Node child = from[node.firstChild + i];
+		child.firstChild = 0;
+		child.childCount = 0;
+		to.push_back(child);
+	}
+
+	for(unsigned i = 0; i < node.childCount; ++i) {
+		_copyChildren(from, node.firstChild + i, to, first + i);
+	}
+}
+
+
+SearchHeroAi::SearchHeroAi(CharacterSP character, Lane lane)
+    : HeroAi(character, lane)
+{
+}
+
+
+AiType SearchHeroAi::type() const {
+	return AI_SEARCH_HERO;
+}
+
+
+void SearchHeroAi::play() {
+	CharacterSP c = character();
+
+	if(!c || !c->isAlive())
+		return;
+
+	TextMoba* tm = c->_textMoba;
+	const SimModel& model = tm->simModel();
+
+	updateStatus();
+
+	// Plans are orders: play them instead of searching.
+	AiAgent agent = _agent(c);
+	if(resumePlan(_plan, agent)) {
+		_search.reset();
+		return;
+	}
+
+	model.capture(tm, _root);
+	if(_root.slotOf(c->index()) < 0) {
+		HeroAi::play();
+		return;
+	}
+
+	SimAction action;
+	if(tm->speculator() && tm->speculator()->take(c->index(), model.stateHash(_root), action)
+	        && _apply(action)) {
+		tm->message(MSG_DEBUG, debugNameOf(c), " plays its speculated action");
+		_search.reset();
+		return;
+	}
+
+	unsigned threadCount = tm->_searchThreads;
+	if(threadCount == 0) {
+		// A fixed number of playouts is only deterministic on a fixed
+		// number of threads.
+		threadCount = tm->_searchPlayouts? 1: std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	bool found = _search.search(model, _root, c->index(), tm->_searchTime,
+	                            tm->_searchPlayouts, threadCount, nullptr, action);
+
+	SearchStats& stats = tm->_searchStats;
+	stats.searches    += 1;
+	stats.playouts    += _search._playouts;
+	stats.time        += _search._time;
+	stats.lastPlayouts = _search._playouts;
+	stats.lastTime     = _search._time;
+	stats.lastNodes    = _search._nodeCount;
+	stats.threads      = threadCount;
+
+	tm->message(MSG_DEBUG, debugNameOf(c), " search: ", _search._playouts,
+	            " playouts in ", _search._time, " us");
+
+	if(!found || !_apply(action)) {
+		_search.reset();
+		HeroAi::play();
+	}
+}
+
+
+bool SearchHeroAi::_apply(const SimAction& action) {
+	CharacterSP c = character();
+	TextMoba* tm = c->_textMoba;
+
+	switch(action.type) {
+	case SIM_NONE:
+	case SIM_WAIT:
+		return true;
+	case SIM_MOVE: {
+		MapNodeSP dest = tm->mapNode(tm->simModel()._nodes.at(action.arg).id);
+		if(!dest)
+			return false;
+		c->moveTo(dest);
+		return true;
+	}
+	case SIM_PLACE:
+		c->goToPlace(Place(action.arg));
+		return true;
+	case SIM_ATTACK: {
+		CharacterSP target = _characterByIndex(action.target);
+		if(!target || !target->isAlive())
+			return false;
+		_target = target;
+		c->attack(target);
+		return true;
+	}
+	case SIM_SKILL: {
+		if(action.arg >= c->skills().size())
+			return false;
+		SkillSP skill = c->skills()[action.arg];
+
+		CharacterVector targets;
+		if(skill->target() == SINGLE) {
+			CharacterSP target = _characterByIndex(action.target);
+			if(target)
+				targets = skill->targets(target);
+		}
+		else if(skill->target() == ANY_ROW) {
+			targets = skill->targets(Place(action.target & 0x01));
+		}
+		else {
+			targets = skill->targets();
+		}
+
+		if(targets.empty())
+			return false;
+
+		c->setMana(c->mana() - skill->manaCost());
+		skill->useOn(targets);
+		return true;
+	}
+	}
+
+	return false;
+}
+
+
+CharacterSP SearchHeroAi::_characterByIndex(unsigned index) const {
+	MapNodeSP node = character()->node();
+	if(node) {
+		for(const CharacterSP& c: node->characters()) {
+			if(c->index() == index)
+				return c;
+		}
+	}
+	return CharacterSP();
+}
@@ -0,0 +1,130 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_SEARCH_HERO_AI_H_
+#define LD41_SEARCH_HERO_AI_H_
+
+
+#include <atomic>
+#include <chrono>
+
+#include <lair/core/lair.h>
+
+#include "sim_state.h"
+
+#include "hero_ai.h"
+
+
+// Monte-Carlo tree search of the action of a hero on the forward model
+// (SimModel). Each worker thread grows its own tree from the same root and
+// the root statistics are merged at the end. Rollouts use the scripted
+// HeroAi behavior.
+class HeroSearch {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	enum {
+		MAX_NODES     = 1 << 16, // per tree
+		ROLLOUT_TURNS = 12,
+	};
+
+	struct Node {
+		SimAction    action;
+		lair::uint32 visits;
+		float        value;
+		lair::uint32 firstChild;
+		lair::uint32 childCount;
+	};
+
+	typedef std::vector<Node> NodeVector;
+
+	struct Tree {
+		NodeVector   nodes;
+		lair::uint64 rng;
+		unsigned     playouts;
+		// Child of the root played this turn, the root of the next search.
+		unsigned     next;
+	};
+
+	typedef std::vector<Tree> TreeVector;
+
+public:
+	HeroSearch();
+
+	// root is the state where the hero chooses its action, in the middle of
+	// a turn (see SimModel::startTurn()). The search stops after time ms, or
+	// after playouts playouts per thread if it is not 0, or when cancel is
+	// set. Returns false if no playout could be done.
+	bool search(const SimModel& model, const SimState& root, unsigned hero,
+	            unsigned time, unsigned playouts, unsigned threadCount,
+	            const std::atomic<bool>* cancel, SimAction& action);
+
+	// Forget the trees kept for the next turn.
+	void reset();
+
+	void _search(unsigned treeIndex, unsigned hero, Clock::time_point deadline,
+	             unsigned playouts, const std::atomic<bool>* cancel);
+	void _playout(Tree& tree, unsigned hero, Team team, SimState& state,
+	              SimActionVector& actions, std::vector<unsigned>& path);
+	unsigned _select(const Tree& tree, unsigned node) const;
+	float _evaluate(const SimState& state, Team team) const;
+
+	void _resetTree(Tree& tree);
+	void _reuseTree(Tree& tree);
+	void _copyChildren(const NodeVector& from, unsigned fromNode,
+	                   NodeVector& to, unsigned toNode);
+
+public:
+	const SimModel* _model;
+	SimState        _root;
+	TreeVector      _trees;
+	SimActionVector _actions;
+	unsigned        _nextTurn;
+
+	// Last search
+	unsigned        _playouts;
+	unsigned        _nodeCount;
+	unsigned        _time;
+	unsigned        _threadCount;
+};
+
+
+// A hero that chooses its actions with a HeroSearch, within a time budget
+// per turn. Uses the action precomputed by the Speculator when there is one.
+// Its state is saved as a HeroAi.
+class SearchHeroAi : public HeroAi {
+public:
+	SearchHeroAi(CharacterSP character, Lane lane);
+
+	virtual AiType type() const override;
+
+	virtual void play() override;
+
+	bool _apply(const SimAction& action);
+	CharacterSP _characterByIndex(unsigned index) const;
+
+public:
+	HeroSearch _search;
+	SimState   _root;
+};
+
+
+#endif
@@ -0,0 +1,1474 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <lair/core/log.h>
+
+#include "map_node.h"
+#include "character_class.h"
+#include "character.h"
+#include "skill.h"
+#include "ai.h"
+#include "hero_ai.h"
+#include "redshirt_ai.h"
+#include "tower_ai.h"
+#include "state_hash.h"
+#include "lane_stats.h"
+#include "lane_planner.h"
+
+#include "sim_state.h"
+
+
+using namespace lair;
+
+
+void SimState::copyFrom(const SimState& other) {
+	std::memcpy(this, &other, offsetof(SimState, chars)
+	                          + other.count * sizeof(SimCharacter));
+}
+
+
+unsigned SimState::random(unsigned range) {
+	// Must match TextMoba::random().
+	rng += 0x9e3779b97f4a7c15ull;
+	return ((hashMix(rng) >> 32) * range) >> 32;
+}
+
+
+int SimState::slotOf(unsigned index) const {
+	for(unsigned i = 0; i < count; ++i) {
+		if(chars[i].index == index)
+			return chars[i].removed? -1: int(i);
+	}
+	return -1;
+}
+
+
+
+SimGroups::SimGroups(const SimState& state, unsigned node)
+    : _state(&state)
+    , _node(node)
+    , _count(0)
+{
+	// Buckets in CharacterGroups order: blue back, blue front, red back,
+	// red front (and anything else).
+	unsigned bucketCount[4] = { 0, 0, 0, 0 };
+	lair::uint8 bucket[SIM_MAX_CHARACTERS];
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.node != node || c.removed || node == SIM_NO_NODE)
+			continue;
+		unsigned b = std::min(2u * c.team + c.place, 3u);
+		bucket[i] = b;
+		bucketCount[b] += 1;
+		_count += 1;
+	}
+
+	_indices[0] = 0;
+	for(unsigned b = 0; b < 3; ++b)
+		_indices[b + 1] = _indices[b] + bucketCount[b];
+	_indices[4] = _count;
+
+	unsigned next[4] = { _indices[0], _indices[1], _indices[2], _indices[3] };
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.node != node || c.removed || node == SIM_NO_NODE)
+			continue;
+		_slots[next[bucket[i]]++] = i;
+	}
+}
+
+
+unsigned SimGroups::count() const {
+	return _count;
+}
+
+
+unsigned SimGroups::count(Team team) const {
+	return _index(team + 1, 0) - _index(team, 0);
+}
+
+
+unsigned SimGroups::count(Team team, Place place) const {
+	return _index(team, place + 1) - _index(team, place);
+}
+
+
+unsigned SimGroups::count(CharType type, Team team) const {
+	unsigned c = 0;
+	unsigned teamCount = count(team);
+	for(unsigned i = 0; i < teamCount; ++i) {
+		if(_state->chars[get(team, i)].type == type) {
+			c += 1;
+		}
+	}
+	return c;
+}
+
+
+unsigned SimGroups::get(Team team, unsigned index) const {
+	return _slots[_index(team, 0) + index];
+}
+
+
+unsigned SimGroups::get(Team team, Place place, unsigned index) const {
+	return _slots[_index(team, place) + index];
+}
+
+
+unsigned SimGroups::distanceBetween(unsigned s0, unsigned s1) const {
+	const SimCharacter& c0 = _state->chars[s0];
+	const SimCharacter& c1 = _state->chars[s1];
+	if(!c0.isAlive() || c0.node != _node ||
+	   !c1.isAlive() || c1.node != _node)
+		return 9999;
+
+	int p0 = placeIndex(Team(c0.team), Place(c0.place));
+	int p1 = placeIndex(Team(c1.team), Place(c1.place));
+
+	if(p0 > p1)
+		std::swap(p0, p1);
+
+	unsigned dist = p1 - p0;
+	for(int i = p0 + 1; i < p1; ++i) {
+		if(!count(teamFromPlaceIndex(i), placeFromPlaceIndex(i))) {
+			dist -= 1;
+		}
+	}
+
+	return dist;
+}
+
+
+int SimGroups::pick(SimState& state, Team team, Place place) const {
+	unsigned c = count(team, place);
+	if(c == 0)
+		return -1;
+	return get(team, place, state.random(c));
+}
+
+
+int SimGroups::closestEnemyRow(unsigned slot, int range) const {
+	const SimCharacter& c = _state->chars[slot];
+	Team team  = Team(c.team);
+	Team enemy = enemyTeam(team);
+
+	if(c.place == BACK && count(team, FRONT)) {
+		range -= 1;
+	}
+
+	if(count(enemy, FRONT)) {
+		if(range > 0) {
+			return FRONT;
+		}
+		range -= 1;
+	}
+
+	if(range > 0 && count(enemy, BACK)) {
+		return BACK;
+	}
+
+	return -1;
+}
+
+
+int SimGroups::pickClosestEnemy(SimState& state, unsigned slot, int range) const {
+	int row = closestEnemyRow(slot, range);
+	return (row >= 0)? pick(state, enemyTeam(Team(_state->chars[slot].team)), Place(row)): -1;
+}
+
+
+unsigned SimGroups::_index(unsigned team, unsigned place) const {
+	return _indices[std::min(2 * team + place, 4u)];
+}
+
+
+
+SimModel::SimModel()
+    : _waveTime(0)
+    , _redshirtPerLane(0)
+    , _fonxusNodes{ SIM_NO_NODE, SIM_NO_NODE }
+    , _redshirtClasses{ 0, 0 }
+{
+}
+
+
+void SimModel::initialize(TextMoba* textMoba) {
+	_classes.clear();
+	_skillModels.clear();
+	_nodes.clear();
+
+	// Sort everything by id so that indices do not depend on hashing.
+	std::vector<const MapNode*> nodes;
+	for(const auto& pair: textMoba->_nodes)
+		nodes.push_back(pair.second.get());
+	std::sort(nodes.begin(), nodes.end(), [](const MapNode* n0, const MapNode* n1) {
+		return n0->id() < n1->id();
+	});
+	if(nodes.size() >= SIM_NO_NODE)
+		dbgLogger.error("SimModel: too many nodes.");
+
+	auto nodeIndex = [&nodes](const MapNode* node) {
+		auto it = std::find(nodes.begin(), nodes.end(), node);
+		return (!node || it == nodes.end())? unsigned(SIM_NO_NODE): unsigned(it - nodes.begin());
+	};
+
+	static const char* dirNames[SIM_DIR_COUNT] = { "blue", "red", "top", "bot" };
+	for(const MapNode* mapNode: nodes) {
+		Node node;
+		node.id     = mapNode->id();
+		node.idHash = hashString(mapNode->id());
+		for(unsigned d = 0; d < SIM_DIR_COUNT; ++d)
+			node.dirs[d] = nodeIndex(mapNode->destination(dirNames[d]).get());
+		for(const auto& path: mapNode->paths())
+			node.neighbors.push_back(nodeIndex(path.first));
+		std::sort(node.neighbors.begin(), node.neighbors.end());
+		node.lane = mapNode->_lane;
+		_nodes.push_back(node);
+	}
+
+	for(Team team: { BLUE, RED }) {
+		_nextHop[team].assign(nodes.size() * nodes.size(), SIM_NO_NODE);
+		for(unsigned from = 0; from < nodes.size(); ++from) {
+			for(unsigned to = 0; to < nodes.size(); ++to) {
+				MapNodeSP hop = textMoba->nextHop(team, textMoba->mapNode(nodes[from]->id()),
+				                                  textMoba->mapNode(nodes[to]->id()));
+				_nextHop[team][from * nodes.size() + to] = nodeIndex(hop.get());
+			}
+		}
+
+		const LaneStats& laneStats = textMoba->laneStats();
+		for(Lane lane: { TOP, BOT }) {
+			_laneDistance[team][lane].resize(nodes.size());
+			_rally[team][lane].resize(nodes.size());
+			for(unsigned i = 0; i < nodes.size(); ++i) {
+				_laneDistance[team][lane][i] = laneStats.laneDistance(team, lane, nodes[i]);
+				_rally[team][lane][i] = nodeIndex(laneStats.rally(team, lane, nodes[i]));
+			}
+		}
+	}
+
+	for(const auto& pair: textMoba->_skillModels)
+		_skillModels.push_back(pair.second);
+	std::sort(_skillModels.begin(), _skillModels.end(),
+	          [](const SkillModelSP& s0, const SkillModelSP& s1) {
+		return s0->id() < s1->id();
+	});
+
+	for(const auto& pair: textMoba->_classes) {
+		const CharacterClass& cc = *pair.second;
+
+		Class cls;
+		cls.id           = cc.id();
+		cls.nameHash     = hashString(cc.name());
+		cls.type         = cc.type();
+		cls.defaultPlace = cc.defaultPlace();
+		cls.sortIndex    = cc.sortIndex();
+		cls.maxHP        = cc.maxHP();
+		cls.maxMana      = cc.maxMana();
+		cls.damage       = cc.damage();
+		cls.range        = cc.range();
+		for(const String& skill: cc.skills()) {
+			for(unsigned i = 0; i < _skillModels.size(); ++i) {
+				if(_skillModels[i]->id() == skill && cls.skills.size() < SIM_MAX_SKILLS)
+					cls.skills.push_back(i);
+			}
+		}
+		_classes.push_back(cls);
+	}
+	std::sort(_classes.begin(), _classes.end(), [](const Class& c0, const Class& c1) {
+		return c0.id < c1.id;
+	});
+
+	_heroNextLevel   = textMoba->_heroNextLevel;
+	_heroXpWorth     = textMoba->_heroXpWorth;
+	_redshirtXpWorth = textMoba->_redshirtXpWorth;
+	_towerXpWorth    = textMoba->_towerXpWorth;
+	_respawnTime     = textMoba->_respawnTime;
+
+	_waveTime        = textMoba->_waveTime;
+	_redshirtPerLane = textMoba->_redshirtPerLane;
+	_behaviorTrees   = textMoba->_behaviorTrees;
+	_planInterval    = textMoba->_planInterval;
+	_planTravelCost  = textMoba->_planTravelCost;
+	_planSwitchCost  = textMoba->_planSwitchCost;
+	_aggregateFights = textMoba->_aggregateFights;
+
+	_fonxusNodes[BLUE] = nodeIndex(textMoba->fonxus(BLUE).get());
+	_fonxusNodes[RED]  = nodeIndex(textMoba->fonxus(RED).get());
+
+	for(unsigned i = 0; i < _classes.size(); ++i) {
+		if(_classes[i].id == "blueshirt")
+			_redshirtClasses[BLUE] = i;
+		if(_classes[i].id == "redshirt")
+			_redshirtClasses[RED] = i;
+	}
+}
+
+
+bool SimModel::isInitialized() const {
+	return !_nodes.empty();
+}
+
+
+void SimModel::capture(TextMoba* textMoba, SimState& state) const {
+	std::memset(&state, 0, offsetof(SimState, chars));
+
+	state.rng             = textMoba->rngState();
+	state.turn            = textMoba->_turn;
+	state.nextWaveCounter = textMoba->_nextWaveCounter;
+	state.charIndex       = textMoba->_charIndex;
+	state.player          = textMoba->player()? textMoba->player()->index(): SIM_NO_CHARACTER;
+	state.blueFonxus      = textMoba->_blueFonxus? textMoba->_blueFonxus->index(): SIM_NO_CHARACTER;
+	state.redFonxus       = textMoba->_redFonxus?  textMoba->_redFonxus->index():  SIM_NO_CHARACTER;
+	state.result          = SIM_RUNNING;
+
+	auto targetIndex = [](const CharacterWP& target) {
+		CharacterSP t = target.lock();
+		return t? t->index(): unsigned(SIM_NO_CHARACTER);
+	};
+
+	state.playerTarget = targetIndex(textMoba->_playerTarget);
+
+	for(const CharacterSP& c: textMoba->characters()) {
+		if(state.count == SIM_MAX_CHARACTERS) {
+			// Captures run on several threads, for every turn: warn once.
+			static std::atomic<bool> warned(false);
+			if(!warned.exchange(true))
+				dbgLogger.warning("SimModel: too many characters, some are ignored.");
+			break;
+		}
+
+		SimCharacter& sc = state.chars[state.count++];
+		std::memset(&sc, 0, sizeof(SimCharacter));
+
+		sc.index = c->index();
+		sc.cls   = 0;
+		while(sc.cls < _classes.size() && _classes[sc.cls].id != c->cClass()->id())
+			sc.cls += 1;
+		sc.type      = c->type();
+		sc.team      = c->team();
+		sc.node      = SIM_NO_NODE;
+		for(unsigned i = 0; c->node() && i < _nodes.size(); ++i) {
+			if(_nodes[i].id == c->node()->id())
+				sc.node = i;
+		}
+		sc.place     = c->place();
+		sc.level     = c->level();
+		sc.xp        = c->xp();
+		sc.hp        = c->hp();
+		sc.mana      = c->mana();
+		sc.deathTime = c->deathTime();
+		sc.target    = SIM_NO_CHARACTER;
+
+		sc.buffCount = std::min<unsigned>(c->_buffs.size(), SIM_MAX_BUFFS);
+		for(unsigned i = 0; i < sc.buffCount; ++i) {
+			sc.buffs[i].ticks  = c->_buffs[i].ticks;
+			sc.buffs[i].type   = c->_buffs[i].type;
+			sc.buffs[i].amount = c->_buffs[i].amount;
+		}
+
+		sc.skillCount = std::min<unsigned>(c->_skills.size(), SIM_MAX_SKILLS);
+		for(unsigned i = 0; i < sc.skillCount; ++i) {
+			sc.skillLevel[i]    = c->_skills[i]->level();
+			sc.skillCooldown[i] = c->_skills[i]->timeBeforeNextUse();
+		}
+
+		AiSP ai = c->ai();
+		if(ai) {
+			sc.ai = ai->type() + 1;
+			switch(ai->type()) {
+			case AI_BASIC:
+				break;
+			case AI_HERO:
+			case AI_SEARCH_HERO: {
+				// Search heroes play like scripted ones in the simulation.
+				const HeroAi* heroAi = static_cast<const HeroAi*>(ai.get());
+				sc.aiStatus = heroAi->_status;
+				sc.lane     = heroAi->_lane;
+				sc.target   = targetIndex(heroAi->_target);
+				sc.plan     = heroAi->_plan;
+				break;
+			}
+			case AI_REDSHIRT: {
+				const RedshirtAi* redshirtAi = static_cast<const RedshirtAi*>(ai.get());
+				sc.lane   = redshirtAi->_lane;
+				sc.target = targetIndex(redshirtAi->_target);
+				break;
+			}
+			case AI_TOWER:
+				sc.target = targetIndex(static_cast<const TowerAi*>(ai.get())->_target);
+				break;
+			}
+		}
+	}
+}
+
+
+uint64 SimModel::stateHash(const SimState& state) const {
+	// Must match TextMoba::stateHash() and Character::computeHash().
+	uint64 hash = zobristKey(HASH_GLOBAL, HASH_TURN,         state.turn)
+	            ^ zobristKey(HASH_GLOBAL, HASH_WAVE_COUNTER, state.nextWaveCounter)
+	            ^ zobristKey(HASH_GLOBAL, HASH_RNG,          state.rng);
+
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.removed)
+			continue;
+
+		auto key = [&c](unsigned field, uint64 value) {
+			return zobristKey(c.index, field, value);
+		};
+
+		hash ^= key(HASH_CLASS, _classes[c.cls].nameHash + c.team)
+		      ^ key(HASH_NODE, (c.node != SIM_NO_NODE)? _nodes[c.node].idHash: 0)
+		      ^ key(HASH_PLACE, c.place)
+		      ^ key(HASH_LEVEL, c.level)
+		      ^ key(HASH_XP, c.xp)
+		      ^ key(HASH_HP, c.hp)
+		      ^ key(HASH_MANA, c.mana)
+		      ^ key(HASH_DEATH_TIME, c.deathTime);
+
+		for(unsigned b = 0; b < c.buffCount; ++b) {
+			const SimBuff& buff = c.buffs[b];
+			hash ^= key(HASH_BUFF, uint64(b) << 48 ^ uint64(buff.ticks) << 40
+			                     ^ uint64(Byte(buff.type)) << 32 ^ uint32(buff.amount));
+		}
+
+		for(unsigned s = 0; s < c.skillCount; ++s) {
+			hash ^= key(HASH_SKILL_LEVEL,    uint64(s) << 32 | c.skillLevel[s])
+			      ^ key(HASH_SKILL_COOLDOWN, uint64(s) << 32 | c.skillCooldown[s]);
+		}
+	}
+
+	return hash;
+}
+
+
+bool SimModel::step(SimState& state, const SimAction& playerAction) const {
+	if(state.result != SIM_RUNNING)
+		return false;
+
+	int player = state.slotOf(state.player);
+	if(player < 0 || !applyAction(state, player, playerAction))
+		return false;
+
+	nextTurn(state);
+	return true;
+}
+
+
+void SimModel::nextTurn(SimState& state) const {
+	if(state.result != SIM_RUNNING)
+		return;
+
+	state.turn += 1;
+	state.nextWaveCounter -= 1;
+
+	if(_planInterval && state.turn % _planInterval == 0) {
+		_planLanes(state, BLUE);
+		_planLanes(state, RED);
+	}
+
+	_playTurn(state, 0, true, false);
+}
+
+
+int SimModel::startTurn(SimState& state) const {
+	if(state.result != SIM_RUNNING)
+		return -1;
+
+	state.turn += 1;
+	state.nextWaveCounter -= 1;
+
+	if(_planInterval && state.turn % _planInterval == 0) {
+		_planLanes(state, BLUE);
+		_planLanes(state, RED);
+	}
+
+	return _playTurn(state, 0, true, true);
+}
+
+
+int SimModel::resumeTurn(SimState& state, unsigned slot) const {
+	if(state.result != SIM_RUNNING)
+		return -1;
+
+	return _playTurn(state, slot + 1, state.chars[slot].team == BLUE, true);
+}
+
+
+void SimModel::finishTurn(SimState& state, unsigned slot) const {
+	if(state.result != SIM_RUNNING)
+		return;
+
+	_playTurn(state, slot + 1, state.chars[slot].team == BLUE, false);
+}
+
+
+void SimModel::actions(const SimState& state, unsigned slot, SimActionVector& actions) const {
+	const SimCharacter& c = state.chars[slot];
+
+	actions.clear();
+	actions.push_back(SimAction{ SIM_WAIT, 0, 0 });
+
+	if(!c.isAlive() || c.node == SIM_NO_NODE)
+		return;
+
+	for(int node: _nodes[c.node].neighbors)
+		actions.push_back(SimAction{ SIM_MOVE, lair::uint8(node), 0 });
+
+	actions.push_back(SimAction{ SIM_PLACE, lair::uint8((c.place == FRONT)? BACK: FRONT), 0 });
+
+	SimGroups groups(state, c.node);
+	Team enemy = enemyTeam(Team(c.team));
+	for(unsigned i = 0; i < groups.count(enemy); ++i) {
+		unsigned target = groups.get(enemy, i);
+		if(groups.distanceBetween(slot, target) <= range(c))
+			actions.push_back(SimAction{ SIM_ATTACK, 0, state.chars[target].index });
+	}
+
+	lair::uint8 targets[SIM_MAX_CHARACTERS];
+	for(unsigned s = 0; s < c.skillCount; ++s) {
+		if(!skillUsable(c, s))
+			continue;
+
+		switch(skillModel(c, s).target(c.skillLevel[s])) {
+		case NO_TARGET:
+			break;
+		case SINGLE: {
+			Team team = skillTargetTeam(c, s);
+			for(unsigned i = 0; i < groups.count(team); ++i) {
+				unsigned target = groups.get(team, i);
+				if(skillTargets(state, slot, s, target, targets))
+					actions.push_back(SimAction{ SIM_SKILL, lair::uint8(s), state.chars[target].index });
+			}
+			break;
+		}
+		case ANY_ROW:
+			for(unsigned place = BACK; place <= FRONT; ++place) {
+				if(skillTargets(state, slot, s, place, targets))
+					actions.push_back(SimAction{ SIM_SKILL, lair::uint8(s), place });
+			}
+			break;
+		default:
+			if(skillTargets(state, slot, s, 0, targets))
+				actions.push_back(SimAction{ SIM_SKILL, lair::uint8(s), 0 });
+			break;
+		}
+	}
+}
+
+
+bool SimModel::applyAction(SimState& state, unsigned slot, const SimAction& action) const {
+	SimCharacter& c = state.chars[slot];
+
+	if(action.type == SIM_NONE || action.type == SIM_WAIT)
+		return true;
+	if(!c.isAlive() || c.node == SIM_NO_NODE)
+		return false;
+
+	switch(action.type) {
+	case SIM_MOVE: {
+		const IntVector& neighbors = _nodes[c.node].neighbors;
+		if(std::find(neighbors.begin(), neighbors.end(), action.arg) == neighbors.end())
+			return false;
+		_move(state, slot, action.arg);
+		return true;
+	}
+	case SIM_PLACE:
+		if(action.arg > FRONT || action.arg == c.place)
+			return false;
+		c.place = action.arg;
+		return true;
+	case SIM_ATTACK: {
+		int target = state.slotOf(action.target);
+		if(target < 0 || !state.chars[target].isAlive() ||
+		   state.chars[target].team == c.team)
+			return false;
+		SimGroups groups(state, c.node);
+		if(groups.distanceBetween(slot, target) > range(c))
+			return false;
+		_attack(state, slot, target);
+		return true;
+	}
+	case SIM_SKILL: {
+		unsigned skill = action.arg;
+		if(skill >= c.skillCount || !skillUsable(c, skill))
+			return false;
+
+		unsigned arg = action.target;
+		if(skillModel(c, skill).target(c.skillLevel[skill]) == SINGLE) {
+			int target = state.slotOf(action.target);
+			if(target < 0 || !state.chars[target].isAlive() ||
+			   state.chars[target].team != skillTargetTeam(c, skill))
+				return false;
+			arg = target;
+		}
+
+		lair::uint8 targets[SIM_MAX_CHARACTERS];
+		unsigned count = skillTargets(state, slot, skill, arg, targets);
+		if(count == 0)
+			return false;
+
+		c.mana -= skillModel(c, skill).manaCost(c.skillLevel[skill]);
+		_useSkill(state, slot, skill, targets, count);
+		return true;
+	}
+	}
+
+	return false;
+}
+
+
+unsigned SimModel::maxHP(const SimCharacter& c) const {
+	return _classes[c.cls].maxHP.at(c.level);
+}
+
+
+unsigned SimModel::maxMana(const SimCharacter& c) const {
+	return _classes[c.cls].maxMana.at(c.level);
+}
+
+
+unsigned SimModel::damage(const SimCharacter& c) const {
+	return _classes[c.cls].damage.at(c.level);
+}
+
+
+unsigned SimModel::range(const SimCharacter& c) const {
+	return _classes[c.cls].range.at(c.level);
+}
+
+
+unsigned SimModel::nextLevel(const SimCharacter& c) const {
+	return (c.type == HERO)? _heroNextLevel.at(c.level): 0;
+}
+
+
+unsigned SimModel::xpWorth(const SimCharacter& c) const {
+	switch(c.type) {
+	case HERO:
+		return _heroXpWorth.at(c.level);
+	case REDSHIRT:
+		return _redshirtXpWorth.at(c.level);
+	case BUILDING:
+		return _towerXpWorth.at(c.level);
+	}
+	return 0;
+}
+
+
+unsigned SimModel::fonxusNode(Team team) const {
+	return _fonxusNodes[team];
+}
+
+
+unsigned SimModel::nextHop(Team team, unsigned from, unsigned to) const {
+	if(from == SIM_NO_NODE || to == SIM_NO_NODE)
+		return SIM_NO_NODE;
+	return _nextHop[team][from * _nodes.size() + to];
+}
+
+
+const SkillModel& SimModel::skillModel(const SimCharacter& c, unsigned skill) const {
+	return *_skillModels[_classes[c.cls].skills[skill]];
+}
+
+
+bool SimModel::skillUsable(const SimCharacter& c, unsigned skill) const {
+	unsigned level = c.skillLevel[skill];
+	return c.isAlive() && level && c.skillCooldown[skill] == 0
+	    && c.mana >= skillModel(c, skill).manaCost(level);
+}
+
+
+Team SimModel::skillTargetTeam(const SimCharacter& c, unsigned skill) const {
+	for(const SkillModel::Effect& effect: skillModel(c, skill).effects()) {
+		switch(effect.type(c.skillLevel[skill])) {
+		case NO_EFFECT:
+			return BLUE;
+		case DAMAGE:
+		case DOT:
+			return enemyTeam(Team(c.team));
+		case HEAL:
+		case HOT:
+			return Team(c.team);
+		}
+	}
+	return BLUE;
+}
+
+
+unsigned SimModel::skillTargets(const SimState& state, unsigned slot, unsigned skill,
+                                unsigned arg, lair::uint8* targets) const {
+	const SimCharacter& c = state.chars[slot];
+	if(!skillUsable(c, skill))
+		return 0;
+
+	const SkillModel& model = skillModel(c, skill);
+	unsigned level = c.skillLevel[skill];
+	unsigned range = model.range(level);
+
+	SimGroups groups(state, c.node);
+	Team team = skillTargetTeam(c, skill);
+
+	unsigned count = 0;
+	auto addInRange = [&](unsigned t, bool heroOnly) {
+		if(groups.distanceBetween(slot, t) <= range &&
+		   (!heroOnly || state.chars[t].type == HERO))
+			targets[count++] = t;
+	};
+
+	switch(model.target(level)) {
+	case NO_TARGET:
+		break;
+	case SELF:
+		targets[count++] = slot;
+		break;
+	case SINGLE:
+		addInRange(arg, false);
+		break;
+	case FRONT_ROW:
+	case BACK_ROW:
+	case ANY_ROW: {
+		Place place = (model.target(level) == FRONT_ROW)? FRONT:
+		              (model.target(level) == BACK_ROW)?  BACK: Place(arg & 0x01);
+		for(unsigned i = 0; i < groups.count(team, place); ++i)
+			addInRange(groups.get(team, place, i), false);
+		break;
+	}
+	case BOTH_ROWS:
+	case HEROES:
+		for(unsigned i = 0; i < groups.count(team); ++i)
+			addInRange(groups.get(team, i), model.target(level) == HEROES);
+		break;
+	}
+
+	return count;
+}
+
+
+int SimModel::_playTurn(SimState& state, unsigned first, bool blueTurns, bool stop) const {
+	// Blue NPC turns
+	unsigned slot = first;
+	if(blueTurns) {
+		if(first == 0)
+			_resolveQuietFights(state, BLUE);
+
+		for(; slot < state.count && state.chars[slot].team == BLUE; ++slot) {
+			if(_npcTurn(state, slot, stop))
+				return slot;
+		}
+
+		// Blue minion waves.
+		if(state.nextWaveCounter == 0) {
+			_compact(state);
+			_spawnRedshirts(state, BLUE);
+		}
+
+		_resolveQuietFights(state, RED);
+
+		slot = 0;
+		while(slot < state.count && state.chars[slot].team == BLUE)
+			++slot;
+	}
+
+	// Red NPC turns
+	for(; slot < state.count; ++slot) {
+		if(_npcTurn(state, slot, stop))
+			return slot;
+	}
+
+	// Red minion waves.
+	if(state.nextWaveCounter == 0) {
+		_compact(state);
+		_spawnRedshirts(state, RED);
+	}
+
+	if(state.nextWaveCounter == 0)
+		state.nextWaveCounter = _waveTime;
+
+	_compact(state);
+
+	// Win-condition
+	int redFonxus  = state.slotOf(state.redFonxus);
+	int blueFonxus = state.slotOf(state.blueFonxus);
+	if(redFonxus < 0 || !state.chars[redFonxus].isAlive()) {
+		state.result = SIM_WIN;
+		return -1;
+	}
+	if(blueFonxus < 0 || !state.chars[blueFonxus].isAlive()) {
+		state.result = SIM_LOSS;
+		return -1;
+	}
+
+	// Player turn
+	int player = state.slotOf(state.player);
+	if(player >= 0) {
+		_charTurn(state, player);
+		_compact(state);
+	}
+
+	return -1;
+}
+
+
+bool SimModel::_npcTurn(SimState& state, unsigned slot, bool stop) const {
+	SimCharacter& c = state.chars[slot];
+	if(c.removed || c.index == state.player)
+		return false;
+
+	if(c.aggregated) {
+		c.aggregated = false;
+		return false;
+	}
+
+	if(stop && c.ai == AI_SEARCH_HERO + 1)
+		return _upkeep(state, slot);
+
+	_charTurn(state, slot);
+	return false;
+}
+
+
+void SimModel::_charTurn(SimState& state, unsigned slot) const {
+	if(_upkeep(state, slot))
+		_play(state, slot);
+}
+
+
+bool SimModel::_upkeep(SimState& state, unsigned slot) const {
+	SimCharacter& c = state.chars[slot];
+
+	if(c.deathTime) {
+		c.deathTime -= 1;
+		if(c.deathTime == 0) {
+			c.hp   = maxHP(c);
+			c.mana = maxMana(c);
+			_move(state, slot, fonxusNode(Team(c.team)));
+			_planLanes(state, Team(c.team));
+		}
+		return false;
+	}
+
+	// Fonxus regen
+	if(c.type == BUILDING) {
+		lair::uint8 targets[SIM_MAX_CHARACTERS];
+		for(unsigned s = 0; s < c.skillCount; ++s) {
+			unsigned count = skillTargets(state, slot, s, 0, targets);
+			_useSkill(state, slot, s, targets, count);
+		}
+	}
+
+	// Hero regens
+	if(c.type == HERO) {
+		_heal(state, slot, 2);
+		c.mana = std::min(c.mana + 1, maxMana(c));
+	}
+
+	SimBuff buffs[SIM_MAX_BUFFS];
+	unsigned buffCount = c.buffCount;
+	std::memcpy(buffs, c.buffs, sizeof(buffs));
+	c.buffCount = 0;
+	for(unsigned i = 0; i < buffCount; ++i) {
+		SimBuff b = buffs[i];
+		switch(b.type) {
+		case 'h':
+			_heal(state, slot, b.amount);
+			break;
+		case 'd':
+			_dealDamage(state, slot, b.amount);
+			break;
+		}
+
+		if(--b.ticks)
+			c.buffs[c.buffCount++] = b;
+	}
+
+	if(!c.isAlive())
+		return false;
+
+	// Cooldowns
+	for(unsigned s = 0; s < c.skillCount; ++s) {
+		if(c.skillCooldown[s] != 0)
+			c.skillCooldown[s] -= 1;
+	}
+
+	return true;
+}
+
+
+void SimModel::_resolveQuietFights(SimState& state, Team team) const {
+	if(!_aggregateFights)
+		return;
+
+	// Per team and heroes per node, in a single pass. Fights do not move
+	// characters, so the counts stay valid from a node to the next.
+	lair::uint8 counts[SIM_NO_NODE][4];
+	std::memset(counts, 0, sizeof(counts));
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.removed || c.node == SIM_NO_NODE)
+			continue;
+		counts[c.node][std::min<unsigned>(c.team, NEUTRAL)] += 1;
+		if(c.type == HERO)
+			counts[c.node][3] += 1;
+	}
+
+	for(unsigned node = 0; node < _nodes.size(); ++node) {
+		if(counts[node][3] || !counts[node][BLUE] || !counts[node][RED])
+			continue;
+
+		lair::uint8 fighters[SIM_MAX_CHARACTERS];
+		unsigned fighterCount = 0;
+		for(unsigned i = 0; i < state.count; ++i) {
+			const SimCharacter& c = state.chars[i];
+			if(!c.removed && c.node == node && c.team == team)
+				fighters[fighterCount++] = i;
+		}
+
+		for(unsigned i = 0; i < fighterCount; ++i) {
+			state.chars[fighters[i]].aggregated = true;
+			_upkeep(state, fighters[i]);
+		}
+
+		SimGroups groups(state, node);
+		for(unsigned i = 0; i < fighterCount; ++i) {
+			const SimCharacter& c = state.chars[fighters[i]];
+			if(!c.isAlive() || c.node != node ||
+			   (c.ai != AI_REDSHIRT + 1 && c.ai != AI_TOWER + 1))
+				continue;
+
+			if(!_attackClosest(state, fighters[i], groups))
+				continue;
+			// Killed shirts and towers are removed.
+			if(state.slotOf(c.target) < 0)
+				groups = SimGroups(state, node);
+		}
+	}
+}
+
+
+namespace {
+
+// The behavior tree leaves for SimModel, like AiAgent for TextMoba.
+struct SimAgent {
+	SimAgent(const SimModel& model, SimState& state, unsigned slot)
+	    : model(model)
+	    , state(state)
+	    , slot(slot)
+	    , groups(state, state.chars[slot].node)
+	{
+	}
+
+	bool leaf(BtOp op, int arg) {
+		return model._leaf(state, slot, groups, op, arg);
+	}
+
+	const SimModel& model;
+	SimState&       state;
+	unsigned        slot;
+	SimGroups       groups;
+};
+
+}
+
+
+void SimModel::_play(SimState& state, unsigned slot) const {
+	SimCharacter& c = state.chars[slot];
+
+	// AI
+	if(c.action.type != SIM_NONE) {
+		SimAction action = c.action;
+		c.action.type = SIM_NONE;
+		applyAction(state, slot, action);
+		return;
+	}
+
+	if(!c.isAlive() || c.ai == 0 || c.ai == AI_BASIC + 1)
+		return;
+
+	SimAgent agent(*this, state, slot);
+	switch(c.ai) {
+	case AI_HERO + 1:
+	case AI_SEARCH_HERO + 1:
+		_behaviorTrees.run(BT_HERO_STATUS, agent);
+		if(!resumePlan(c.plan, agent)) {
+			_behaviorTrees.run(BT_HERO, agent);
+			resumePlan(c.plan, agent);
+		}
+		break;
+	case AI_REDSHIRT + 1:
+		_behaviorTrees.run(BT_REDSHIRT, agent);
+		break;
+	case AI_TOWER + 1:
+		_behaviorTrees.run(BT_TOWER, agent);
+		break;
+	}
+}
+
+
+bool SimModel::_leaf(SimState& state, unsigned slot, const SimGroups& groups,
+                     BtOp op, int arg) const {
+	SimCharacter& c = state.chars[slot];
+	Team team  = Team(c.team);
+	Team enemy = enemyTeam(team);
+	bool hero  = c.ai == AI_HERO + 1 || c.ai == AI_SEARCH_HERO + 1;
+	bool lane  = hero || c.ai == AI_REDSHIRT + 1;
+
+	switch(op) {
+	case BT_SELECTOR:
+	case BT_SEQUENCE:
+	case BT_NOT:
+	case BT_ALWAYS:
+	case BT_OP_COUNT:
+		break;
+
+	case BT_HP_BELOW:
+		return int(c.hp) < int(maxHP(c)) * arg / 100;
+	case BT_RESTED:
+		return c.hp == maxHP(c) && c.mana == maxMana(c);
+	case BT_ENEMIES:
+		return int(groups.count(enemy)) >= arg;
+	case BT_ALLIED_REDSHIRTS:
+		return int(groups.count(REDSHIRT, team)) >= arg;
+	case BT_ALLIED_TOWERS:
+		return int(groups.count(BUILDING, team)) >= arg;
+	case BT_RANGE_IS:
+		return int(range(c)) == arg;
+	case BT_IN_ROW:
+		return c.place == arg;
+	case BT_STATUS:
+		return hero && c.aiStatus == arg;
+	case BT_AT_FONXUS:
+		return c.node == fonxusNode(team);
+	case BT_OFF_LANE:
+		return lane && _nodes[c.node].lane != c.lane && c.node != fonxusNode(team);
+	case BT_ON_LANE:
+		return lane && _nodes[c.node].lane == c.lane;
+	case BT_PLAN_ELAPSED:
+		return hero && c.plan.type != PLAN_NONE && int(state.turn - c.plan.start) >= arg;
+
+	case BT_SET_STATUS:
+		if(!hero)
+			return false;
+		c.aiStatus = arg;
+		return true;
+	case BT_ATTACK_CLOSEST:
+		return _attackClosest(state, slot, groups);
+	case BT_MOVE:
+		return _moveOnLane(state, slot, arg == HeroAi::FORWARD, lane);
+	case BT_GO_TO_FONXUS:
+		return _moveToward(state, slot, fonxusNode(team));
+	case BT_JOIN_LANE: {
+		if(!lane)
+			return false;
+		unsigned rally = _rally[team][c.lane][c.node];
+		return rally != SIM_NO_NODE && _moveToward(state, slot, rally);
+	}
+	case BT_SET_ROW:
+		if(c.place == arg)
+			return false;
+		c.place = arg;
+		return true;
+	case BT_USE_SKILL:
+		return _aiUseSkill(state, slot, groups, _behaviorTrees._strings[arg]);
+	case BT_FOLLOW_PLAYER:
+		return _followPlayer(state, slot, groups);
+	case BT_START_PLAN:
+		if(!hero)
+			return false;
+		c.plan.type  = arg;
+		c.plan.step  = 0;
+		c.plan.start = state.turn;
+		return true;
+	}
+
+	return false;
+}
+
+
+bool SimModel::_attackClosest(SimState& state, unsigned slot, const SimGroups& groups) const {
+	SimCharacter& c = state.chars[slot];
+
+	int target = state.slotOf(c.target);
+	if(target < 0 || !state.chars[target].isAlive() ||
+	        groups.distanceBetween(slot, target) > range(c)) {
+		target = groups.pickClosestEnemy(state, slot, range(c));
+	}
+
+	if(target >= 0) {
+		c.target = state.chars[target].index;
+		_attack(state, slot, target);
+	}
+
+	return target >= 0;
+}
+
+
+bool SimModel::_followPlayer(SimState& state, unsigned slot, const SimGroups& groups) const {
+	SimCharacter& c = state.chars[slot];
+
+	int player = state.slotOf(state.player);
+	if(player < 0 || !state.chars[player].isAlive() || state.chars[player].team != c.team)
+		return false;
+	if(state.chars[player].node != c.node)
+		return _moveToward(state, slot, state.chars[player].node);
+
+	int target = state.slotOf(state.playerTarget);
+	if(target >= 0 && state.chars[target].isAlive() && state.chars[target].node == c.node
+	        && groups.distanceBetween(slot, target) <= range(c)) {
+		c.target = state.chars[target].index;
+		_attack(state, slot, target);
+		return true;
+	}
+
+	return _attackClosest(state, slot, groups);
+}
+
+
+bool SimModel::_moveOnLane(SimState& state, unsigned slot, bool forward, bool lane) const {
+	SimCharacter& c = state.chars[slot];
+	const Node& node = _nodes[c.node];
+
+	Team dir = forward? enemyTeam(Team(c.team)): Team(c.team);
+	unsigned dest = node.dirs[(dir == BLUE)? SIM_DIR_BLUE: SIM_DIR_RED];
+	if(dest == SIM_NO_NODE && lane) {
+		dest = node.dirs[(c.lane == TOP)? SIM_DIR_TOP: SIM_DIR_BOT];
+	}
+
+	if(dest != SIM_NO_NODE) {
+		_move(state, slot, dest);
+	}
+
+	return dest != SIM_NO_NODE;
+}
+
+
+bool SimModel::_moveToward(SimState& state, unsigned slot, unsigned node) const {
+	SimCharacter& c = state.chars[slot];
+	unsigned hop = nextHop(Team(c.team), c.node, node);
+	if(hop != SIM_NO_NODE) {
+		_move(state, slot, hop);
+	}
+
+	return hop != SIM_NO_NODE;
+}
+
+
+bool SimModel::_aiUseSkill(SimState& state, unsigned slot, const SimGroups& groups,
+                           const String& id) const {
+	SimCharacter& c = state.chars[slot];
+
+	unsigned skill = 0;
+	while(skill < c.skillCount && skillModel(c, skill).id() != id)
+		++skill;
+	if(skill == c.skillCount || !skillUsable(c, skill))
+		return false;
+
+	// Same targets as AiAgent::useSkill().
+	unsigned arg = 0;
+	Team team = skillTargetTeam(c, skill);
+	const SkillModel& model = skillModel(c, skill);
+	switch(model.target(c.skillLevel[skill])) {
+	case SINGLE: {
+		int target = (team == c.team)?
+		                 int(slot): groups.pickClosestEnemy(state, slot, model.range(c.skillLevel[skill]));
+		if(target < 0)
+			return false;
+		arg = state.chars[target].index;
+		break;
+	}
+	case ANY_ROW:
+		arg = groups.count(team, FRONT)? FRONT: BACK;
+		break;
+	default:
+		break;
+	}
+
+	return applyAction(state, slot, SimAction{ SIM_SKILL, lair::uint8(skill), arg });
+}
+
+
+void SimModel::_planLanes(SimState& state, Team team) const {
+	Team enemy = enemyTeam(team);
+
+	LanePlan plan;
+	plan.heroCount = 0;
+	plan.need[TOP] = 0;
+	plan.need[BOT] = 0;
+
+	unsigned slots[LanePlan::MAX_HEROES];
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& c = state.chars[i];
+		if(c.removed)
+			continue;
+
+		int lane = (c.node != SIM_NO_NODE)? _nodes[c.node].lane: int(LaneStats::NO_LANE);
+		if(c.type == HERO && c.team == team) {
+			unsigned node = (c.node != SIM_NO_NODE)? c.node: fonxusNode(team);
+			if(c.ai != AI_HERO + 1 && c.ai != AI_SEARCH_HERO + 1) {
+				lane = _nodes[node].lane;
+				if(lane != LaneStats::NO_LANE)
+					plan.need[lane] -= maxHP(c);
+				continue;
+			}
+			if(plan.heroCount == LanePlan::MAX_HEROES)
+				continue;
+
+			LanePlan::Hero& hero = plan.heroes[plan.heroCount];
+			hero.strength      = maxHP(c);
+			hero.distance[TOP] = _laneDistance[team][TOP][node];
+			hero.distance[BOT] = _laneDistance[team][BOT][node];
+			hero.lane          = Lane(c.lane);
+			slots[plan.heroCount++] = i;
+		}
+		else if(lane != LaneStats::NO_LANE && (c.type == HERO || c.type == REDSHIRT)) {
+			if(c.team == enemy)
+				plan.need[lane] += c.hp;
+			else if(c.type == REDSHIRT)
+				plan.need[lane] -= c.hp;
+		}
+	}
+
+	plan.solve(_planTravelCost, _planSwitchCost);
+
+	for(unsigned h = 0; h < plan.heroCount; ++h)
+		state.chars[slots[h]].lane = plan.heroes[h].lane;
+}
+
+
+void SimModel::_move(SimState& state, unsigned slot, unsigned node) const {
+	SimCharacter& c = state.chars[slot];
+	c.node  = node;
+	c.place = _classes[c.cls].defaultPlace;
+}
+
+
+void SimModel::_attack(SimState& state, unsigned attacker, unsigned target) const {
+	if(state.chars[attacker].index == state.player)
+		state.playerTarget = state.chars[target].index;
+
+	_dealDamage(state, target, damage(state.chars[attacker]));
+}
+
+
+void SimModel::_dealDamage(SimState& state, unsigned target, unsigned damage) const {
+	SimCharacter& c = state.chars[target];
+
+	// Already killed, by a previous effect of the same skill.
+	if(!c.isAlive())
+		return;
+
+	if(damage >= c.hp) {
+		c.hp = 0;
+		_kill(state, target);
+	}
+	else {
+		c.hp -= damage;
+	}
+}
+
+
+void SimModel::_heal(SimState& state, unsigned target, unsigned amount) const {
+	SimCharacter& c = state.chars[target];
+	if(c.isAlive()) {
+		c.hp = std::min(c.hp + amount, maxHP(c));
+	}
+}
+
+
+void SimModel::_kill(SimState& state, unsigned slot) const {
+	SimCharacter& c = state.chars[slot];
+
+	unsigned xp = xpWorth(c);
+	for(unsigned i = 0; i < state.count; ++i) {
+		const SimCharacter& other = state.chars[i];
+		if(other.removed || other.node != c.node ||
+		   other.team == c.team || other.type != HERO)
+			continue;
+
+		_grantXp(state, i, xp);
+	}
+
+	c.node  = SIM_NO_NODE;
+	c.place = _classes[c.cls].defaultPlace;
+
+	if(c.type == HERO) {
+		// +1 because it will be decremented almost instantly.
+		c.deathTime = _respawnTime.at(c.level) + 1;
+	}
+	else {
+		c.removed = true;
+
+		if(_classes[c.cls].id == "tower") {
+			_planLanes(state, BLUE);
+			_planLanes(state, RED);
+		}
+	}
+}
+
+
+void SimModel::_grantXp(SimState& state, unsigned slot, unsigned xp) const {
+	SimCharacter& c = state.chars[slot];
+
+	unsigned nextLevelXp = nextLevel(c);
+	if(nextLevelXp == 0)
+		return;
+
+	c.xp += xp;
+	if(c.xp < nextLevelXp)
+		return;
+
+	// Level-up !
+	if(c.team == BLUE) {
+		float hpRatio   = float(c.hp)   / float(maxHP(c));
+		float manaRatio = float(c.mana) / float(maxMana(c));
+
+		c.level += 1;
+		c.xp    -= nextLevelXp;
+
+		c.hp   = maxHP(c)   * hpRatio;
+		c.mana = maxMana(c) * manaRatio;
+
+		unsigned skill = c.level % 3;
+		if(skill < c.skillCount) {
+			c.skillLevel[skill] += 1;
+		}
+
+		if(nextLevel(c) == 0)
+			c.xp = 0;
+	}
+}
+
+
+void SimModel::_addBuff(SimState& state, unsigned slot, const SimBuff& buff) const {
+	SimCharacter& c = state.chars[slot];
+	if(c.buffCount < SIM_MAX_BUFFS)
+		c.buffs[c.buffCount++] = buff;
+}
+
+
+void SimModel::_useSkill(SimState& state, unsigned slot, unsigned skill,
+                         const lair::uint8* targets, unsigned count) const {
+	const SkillModel& model = skillModel(state.chars[slot], skill);
+
+	for(unsigned i = 0; i < count; ++i) {
+		unsigned target = targets[i];
+		unsigned level  = state.chars[slot].skillLevel[skill];
+
+		for(const SkillModel::Effect& effect: model.effects()) {
+			unsigned power = effect.power(level);
+
+			switch(effect.type(level)) {
+			case NO_EFFECT:
+				break;
+			case DAMAGE:
+				_dealDamage(state, target, power);
+				break;
+			case HEAL:
+				if(state.chars[target].hp != maxHP(state.chars[target]))
+					_heal(state, target, power);
+				break;
+			case DOT:
+				_addBuff(state, target, SimBuff{ 3, 'd', int32(power) });
+				break;
+			case HOT:
+				_addBuff(state, target, SimBuff{ 3, 'h', int32(power) });
+				break;
+			}
+		}
+	}
+
+	SimCharacter& c = state.chars[slot];
+	c.skillCooldown[skill] = skillModel(c, skill).cooldown(c.skillLevel[skill]) + 1;
+}
+
+
+void SimModel::_spawnRedshirts(SimState& state, Team team) const {
+	for(unsigned i = 0; i < _redshirtPerLane; ++i) {
+		_spawn(state, _redshirtClasses[team], team, fonxusNode(team), TOP);
+		_spawn(state, _redshirtClasses[team], team, fonxusNode(team), BOT);
+	}
+}
+
+
+void SimModel::_spawn(SimState& state, unsigned cls, Team team, unsigned node, Lane lane) const {
+	unsigned index = state.charIndex++;
+
+	// The state is full: drop the newcomer. The simulation is not exact
+	// anymore, but this only happens in absurdly long games.
+	if(state.count == SIM_MAX_CHARACTERS)
+		return;
+
+	const Class& cc = _classes[cls];
+
+	SimCharacter c;
+	std::memset(&c, 0, sizeof(SimCharacter));
+	c.index      = index;
+	c.target     = SIM_NO_CHARACTER;
+	c.cls        = cls;
+	c.type       = cc.type;
+	c.team       = team;
+	c.node       = node;
+	c.place      = cc.defaultPlace;
+	c.ai         = AI_REDSHIRT + 1;
+	c.lane       = lane;
+	c.hp         = cc.maxHP.at(0);
+	c.mana       = cc.maxMana.at(0);
+	c.skillCount = cc.skills.size();
+	for(unsigned s = 0; s < c.skillCount; ++s)
+		c.skillLevel[s] = 1;
+
+	// Keep the CharacterOrder: team, sort index, index.
+	unsigned pos = state.count;
+	while(pos > 0) {
+		const SimCharacter& prev = state.chars[pos - 1];
+		int prevSort = _classes[prev.cls].sortIndex;
+		if(prev.team < c.team ||
+		   (prev.team == c.team && (prevSort < cc.sortIndex ||
+		                            (prevSort == cc.sortIndex && prev.index < c.index))))
+			break;
+		pos -= 1;
+	}
+
+	std::memmove(&state.chars[pos + 1], &state.chars[pos],
+	             (state.count - pos) * sizeof(SimCharacter));
+	state.chars[pos] = c;
+	state.count += 1;
+}
+
+
+void SimModel::_compact(SimState& state) const {
+	unsigned dst = 0;
+	for(unsigned src = 0; src < state.count; ++src) {
+		if(state.chars[src].removed)
+			continue;
+		if(dst != src)
+			state.chars[dst] = state.chars[src];
+		dst += 1;
+	}
+	state.count = dst;
+}
@@ -0,0 +1,316 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_SIM_STATE_H_
+#define LD41_SIM_STATE_H_
+
+
+#include <type_traits>
+
+#include <lair/core/lair.h>
+
+#include "text_moba.h"
+#include "ai_plan.h"
+
+
+// A plain-old-data copy of the game state, cheap to clone, and SimModel, a
+// forward model that plays turns on it with the same rules as TextMoba.
+// This is meant for AI lookahead: it does not print anything.
+//
+// Characters are stored in the same order as TextMoba::characters() and
+// refer to each other by character index, never by pointer.
+
+enum {
+	SIM_MAX_CHARACTERS = 128,
+	SIM_MAX_BUFFS      = 8,
+	SIM_MAX_SKILLS     = 4,
+
+	SIM_NO_NODE      = 0xff,
+	SIM_NO_CHARACTER = 0xffffffffu,
+};
+
+enum SimDirection {
+	SIM_DIR_BLUE,
+	SIM_DIR_RED,
+	SIM_DIR_TOP,
+	SIM_DIR_BOT,
+	SIM_DIR_COUNT,
+};
+
+enum SimActionType {
+	SIM_NONE,
+	SIM_WAIT,
+	SIM_MOVE,   // arg: destination node
+	SIM_PLACE,  // arg: place
+	SIM_ATTACK, // target: character index
+	SIM_SKILL,  // arg: skill slot, target: character index or place
+};
+
+enum SimResult {
+	SIM_RUNNING,
+	SIM_WIN,
+	SIM_LOSS,
+};
+
+
+struct SimAction {
+	lair::uint8  type;
+	lair::uint8  arg;
+	lair::uint32 target;
+};
+
+inline bool operator==(const SimAction& a0, const SimAction& a1) {
+	return a0.type == a1.type && a0.arg == a1.arg && a0.target == a1.target;
+}
+
+typedef std::vector<SimAction> SimActionVector;
+
+struct SimBuff {
+	lair::uint8  ticks;
+	char         type;
+	lair::int32  amount;
+};
+
+struct SimCharacter {
+	lair::uint32 index;
+	lair::uint32 target;    // AI sticky target
+	lair::uint8  cls;
+	lair::uint8  type;
+	lair::uint8  team;
+	lair::uint8  node;
+	lair::uint8  place;
+	lair::uint8  level;
+	lair::uint8  ai;        // AiType + 1, 0 if none
+	lair::uint8  aiStatus;
+	lair::uint8  lane;
+	lair::uint8  buffCount;
+	lair::uint8  skillCount;
+	lair::uint8  removed;   // killed, erased at the end of the turn
+	lair::uint8  aggregated;  // turn already played by _resolveQuietFights()
+	AiPlanState  plan;
+	lair::uint32 deathTime;
+	lair::uint32 xp;
+	lair::uint32 hp;
+	lair::uint32 mana;
+	SimAction    action;    // played instead of the AI if set
+	lair::uint8  skillLevel[SIM_MAX_SKILLS];
+	lair::uint8  skillCooldown[SIM_MAX_SKILLS];
+	SimBuff      buffs[SIM_MAX_BUFFS];
+
+	inline bool isAlive() const {
+		return hp > 0;
+	}
+};
+
+struct SimState {
+	lair::uint64 rng;
+	lair::uint32 turn;
+	lair::uint32 nextWaveCounter;
+	lair::uint32 charIndex;
+	lair::uint32 player;
+	lair::uint32 playerTarget;
+	lair::uint32 blueFonxus;
+	lair::uint32 redFonxus;
+	lair::uint32 result;
+	lair::uint32 count;
+	SimCharacter chars[SIM_MAX_CHARACTERS];
+
+	// Only copies the characters in use.
+	void copyFrom(const SimState& other);
+
+	unsigned random(unsigned range);
+
+	// Returns the slot of the character with the given index, or -1.
+	int slotOf(unsigned index) const;
+};
+
+static_assert(std::is_trivially_copyable<SimState>::value,
+              "SimState must be trivially copyable");
+
+
+// Same as CharacterGroups, for a node of a SimState. Holds slots.
+class SimGroups {
+public:
+	SimGroups(const SimState& state, unsigned node);
+
+	unsigned count() const;
+	unsigned count(Team team) const;
+	unsigned count(Team team, Place place) const;
+	unsigned count(CharType type, Team team) const;
+
+	unsigned get(Team team, unsigned index) const;
+	unsigned get(Team team, Place place, unsigned index) const;
+
+	unsigned distanceBetween(unsigned s0, unsigned s1) const;
+
+	int pick(SimState& state, Team team, Place place) const;
+	int closestEnemyRow(unsigned slot, int range) const;
+	int pickClosestEnemy(SimState& state, unsigned slot, int range) const;
+
+	unsigned _index(unsigned team, unsigned place) const;
+
+public:
+	const SimState* _state;
+	unsigned        _node;
+	unsigned        _count;
+	unsigned        _indices[5];
+	lair::uint8     _slots[SIM_MAX_CHARACTERS];
+};
+
+
+class SimModel {
+public:
+	struct Class {
+		lair::String id;
+		lair::uint64 nameHash;
+		CharType     type;
+		Place        defaultPlace;
+		int          sortIndex;
+		IntVector    maxHP;
+		IntVector    maxMana;
+		IntVector    damage;
+		IntVector    range;
+		IntVector    skills;
+	};
+
+	struct Node {
+		lair::String id;
+		lair::uint64 idHash;
+		unsigned     dirs[SIM_DIR_COUNT];
+		IntVector    neighbors;
+		int          lane;
+	};
+
+	typedef std::vector<Class>        ClassVector;
+	typedef std::vector<Node>         NodeVector;
+	typedef std::vector<SkillModelSP> SkillModelVector;
+
+public:
+	SimModel();
+
+	// Builds the static tables from the game rules. Must be called again
+	// if textMoba is reinitialized.
+	void initialize(TextMoba* textMoba);
+	bool isInitialized() const;
+
+	void capture(TextMoba* textMoba, SimState& state) const;
+
+	// Same value as TextMoba::stateHash() for the same state.
+	lair::uint64 stateHash(const SimState& state) const;
+
+	// Plays the player action followed by a turn, like a player command.
+	// Returns false (and does nothing) if the action is not valid.
+	bool step(SimState& state, const SimAction& playerAction) const;
+	void nextTurn(SimState& state) const;
+	// Plays the rest of the current turn after the character in slot, as
+	// TextMoba does after its Ai::play().
+	void finishTurn(SimState& state, unsigned slot) const;
+
+	// Starts a turn and plays it until a character with a search AI has to
+	// choose its action. Returns its slot, or -1 once the turn is over.
+	int startTurn(SimState& state) const;
+	// Continues the turn after the character in slot acted, with the same
+	// stops as startTurn().
+	int resumeTurn(SimState& state, unsigned slot) const;
+
+	// The valid actions of the character in slot, waiting first.
+	void actions(const SimState& state, unsigned slot, SimActionVector& actions) const;
+
+	bool applyAction(SimState& state, unsigned slot, const SimAction& action) const;
+
+	unsigned maxHP(const SimCharacter& c) const;
+	unsigned maxMana(const SimCharacter& c) const;
+	unsigned damage(const SimCharacter& c) const;
+	unsigned range(const SimCharacter& c) const;
+	unsigned nextLevel(const SimCharacter& c) const;
+	unsigned xpWorth(const SimCharacter& c) const;
+	unsigned fonxusNode(Team team) const;
+	// Same as TextMoba::nextHop().
+	unsigned nextHop(Team team, unsigned from, unsigned to) const;
+
+	const SkillModel& skillModel(const SimCharacter& c, unsigned skill) const;
+	bool skillUsable(const SimCharacter& c, unsigned skill) const;
+	Team skillTargetTeam(const SimCharacter& c, unsigned skill) const;
+	// arg is the target slot for SINGLE skills and the place for ANY_ROW.
+	unsigned skillTargets(const SimState& state, unsigned slot, unsigned skill,
+	                      unsigned arg, lair::uint8* targets) const;
+
+	int _playTurn(SimState& state, unsigned first, bool blueTurns, bool stop) const;
+	bool _npcTurn(SimState& state, unsigned slot, bool stop) const;
+	void _charTurn(SimState& state, unsigned slot) const;
+	bool _upkeep(SimState& state, unsigned slot) const;
+	void _play(SimState& state, unsigned slot) const;
+	// Same as AiAgent::leaf().
+	bool _leaf(SimState& state, unsigned slot, const SimGroups& groups,
+	           BtOp op, int arg) const;
+	bool _attackClosest(SimState& state, unsigned slot, const SimGroups& groups) const;
+	bool _followPlayer(SimState& state, unsigned slot, const SimGroups& groups) const;
+	bool _moveOnLane(SimState& state, unsigned slot, bool forward, bool lane) const;
+	bool _moveToward(SimState& state, unsigned slot, unsigned node) const;
+	bool _aiUseSkill(SimState& state, unsigned slot, const SimGroups& groups,
+	                 const lair::String& id) const;
+	void _planLanes(SimState& state, Team team) const;
+	// Same as TextMoba::_resolveQuietFights().
+	void _resolveQuietFights(SimState& state, Team team) const;
+
+	void _move(SimState& state, unsigned slot, unsigned node) const;
+	void _attack(SimState& state, unsigned attacker, unsigned target) const;
+	void _dealDamage(SimState& state, unsigned target, unsigned damage) const;
+	void _heal(SimState& state, unsigned target, unsigned amount) const;
+	void _kill(SimState& state, unsigned slot) const;
+	void _grantXp(SimState& state, unsigned slot, unsigned xp) const;
+	void _addBuff(SimState& state, unsigned slot, const SimBuff& buff) const;
+	void _useSkill(SimState& state, unsigned slot, unsigned skill,
+	               const lair::uint8* targets, unsigned count) const;
+
+	void _spawnRedshirts(SimState& state, Team team) const;
+	void _spawn(SimState& state, unsigned cls, Team team, unsigned node, Lane lane) const;
+	void _compact(SimState& state) const;
+
+public:
+	ClassVector      _classes;
+	SkillModelVector _skillModels;
+	NodeVector       _nodes;
+	// Next node on the shortest path from / to, per team.
+	std::vector<lair::uint8> _nextHop[2];
+	// Same as LaneStats::laneDistance() / rally(), by [team][lane][node].
+	std::vector<lair::uint16> _laneDistance[2][2];
+	std::vector<lair::uint8>  _rally[2][2];
+	BehaviorTrees             _behaviorTrees;
+
+	IntVector _heroNextLevel;
+	IntVector _heroXpWorth;
+	IntVector _redshirtXpWorth;
+	IntVector _towerXpWorth;
+	IntVector _respawnTime;
+
+	unsigned _waveTime;
+	unsigned _redshirtPerLane;
+	unsigned _planInterval;
+	unsigned _planTravelCost;
+	unsigned _planSwitchCost;
+	bool     _aggregateFights;
+	unsigned _fonxusNodes[2];
+	unsigned _redshirtClasses[2];
+};
+
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "sim_thread.h"
+
+
+using namespace lair;
+
+
+SimThread::OutputSink::OutputSink(SimThread* thread)
+    : _thread(thread)
+{
+}
+
+
+MessageMask SimThread::OutputSink::wantedMessages() const {
+	return messageBit(MSG_CONSOLE);
+}
+
+
+void SimThread::OutputSink::write(MessageKind /*kind*/, const String& message) {
+	// The window thread empties the queue every tick, so it is only full
+	// if it is stuck. Keep the output rather than dropping it.
+	String line = message;
+	while(!_thread->_output.push(std::move(line))) {
+		if(!_thread->_running.load())
+			return;
+		std::this_thread::yield();
+	}
+}
+
+
+
+SimThread::SimThread(TextMoba* textMoba)
+    : _textMoba(textMoba)
+    , _outputSink(this)
+    , _ready(0)
+    , _building(1)
+    , _reading(2)
+    , _running(false)
+{
+}
+
+
+SimThread::~SimThread() {
+	stop();
+}
+
+
+bool SimThread::isRunning() const {
+	return _running.load();
+}
+
+
+void SimThread::start(const BuildModel& buildModel) {
+	if(_running)
+		return;
+
+	_buildModel = buildModel;
+
+	_textMoba->removeMessageSink(&_textMoba->consoleSink());
+	_textMoba->addMessageSink(&_outputSink);
+
+	_publish();
+
+	_running = true;
+	_thread = std::thread(&SimThread::_run, this);
+}
+
+
+void SimThread::stop() {
+	if(!_running)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_running = false;
+	}
+	_wakeUp.notify_one();
+	_thread.join();
+
+	_textMoba->removeMessageSink(&_outputSink);
+	_textMoba->addMessageSink(&_textMoba->consoleSink());
+}
+
+
+bool SimThread::post(const String& command) {
+	String copy = command;
+	if(!_commands.push(std::move(copy)))
+		return false;
+
+	// Taking the lock makes sure the simulation thread is either before its
+	// check of the queue or waiting, so the notification is not lost.
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+	_wakeUp.notify_one();
+	return true;
+}
+
+
+bool SimThread::popOutput(String& output) {
+	return _output.pop(output);
+}
+
+
+const ViewModel* SimThread::acquire() {
+	if(!(_ready.load(std::memory_order_relaxed) & FRESH_BIT))
+		return nullptr;
+
+	_reading = _ready.exchange(_reading, std::memory_order_acq_rel) & INDEX_MASK;
+	return &_models[_reading];
+}
+
+
+void SimThread::_run() {
+	String command;
+	while(_running.load()) {
+		if(_commands.pop(command)) {
+			_textMoba->_execCommand(command);
+			_publish();
+		}
+		else {
+			// Sleep until a command or stop() comes.
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wakeUp.wait(lock, [this] {
+				return !_commands.empty() || !_running.load();
+			});
+		}
+	}
+}
+
+
+void SimThread::_publish() {
+	ViewModel& model = _models[_building];
+	_buildModel(model);
+
+	_building = _ready.exchange(_building | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+
+	if(onPublish)
+		onPublish();
+}
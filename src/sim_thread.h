@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_SIM_THREAD_H_
+#define LD41_SIM_THREAD_H_
+
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <lair/core/lair.h>
+
+#include "message_sink.h"
+#include "spsc_queue.h"
+#include "text_moba.h"
+
+
+// What the window shows of the game. Built by the simulation thread after
+// each command and only read by the window thread, so it must not point to
+// anything the simulation changes. Map nodes are never destroyed once the
+// game is initialized, but only their position may be read: their image
+// depends on the characters.
+struct ViewModel {
+	// The icon of a character alive on the map.
+	struct Icon {
+		unsigned character;
+		MapNode* node;
+		int      tile;
+		Team     team;
+	};
+	typedef std::vector<Icon> IconVector;
+
+	// An enemy in the first person view.
+	struct ViewChar {
+		lair::String image;
+		Place        place;
+	};
+	typedef std::vector<ViewChar> ViewCharVector;
+
+	lair::String   stats;
+	// In the order of TextMoba::characters().
+	IconVector     icons;
+	// The first person view is hidden if viewImage is empty.
+	lair::String   viewImage;
+	ViewCharVector viewChars;
+};
+
+
+// Runs TextMoba on its own thread, so that the window stays responsive
+// while a turn is played. Commands are sent to it and its console output
+// comes back through lock-free single-producer / single-consumer queues.
+// After each command, it builds a new ViewModel and publishes it through a
+// triple buffer: the window always reads a complete model, and neither side
+// ever waits for the other.
+class SimThread {
+public:
+	typedef std::function<void(ViewModel&)> BuildModel;
+	typedef std::function<void()>           PublishCallback;
+
+	enum {
+		COMMAND_QUEUE_SIZE = 64,
+		OUTPUT_QUEUE_SIZE  = 256,
+	};
+
+public:
+	SimThread(TextMoba* textMoba);
+	SimThread(const SimThread&) = delete;
+	~SimThread();
+
+	SimThread& operator=(const SimThread&) = delete;
+
+	bool isRunning() const;
+
+	// From now on, only the simulation thread may use the TextMoba. Its
+	// console output is redirected to the output queue, and a first model
+	// is published.
+	void start(const BuildModel& buildModel);
+	// Waits for the current command to end and gives the TextMoba back to
+	// the calling thread.
+	void stop();
+
+	// Window thread only. Returns false if too many commands are pending.
+	bool post(const lair::String& command);
+	// Window thread only. Returns false when there is no more output.
+	bool popOutput(lair::String& output);
+	// Window thread only. Returns the last model published since the
+	// previous call, or null. It stays valid until the next call.
+	const ViewModel* acquire();
+
+public:
+	// Called on the simulation thread after each publication, to wake up
+	// the window thread.
+	PublishCallback onPublish;
+
+private:
+	// Sends the console messages to the output queue.
+	class OutputSink : public MessageSink {
+	public:
+		OutputSink(SimThread* thread);
+
+		virtual MessageMask wantedMessages() const override;
+		virtual void write(MessageKind kind, const lair::String& message) override;
+
+	public:
+		SimThread* _thread;
+	};
+
+	enum {
+		FRESH_BIT  = 4,
+		INDEX_MASK = 3,
+	};
+
+private:
+	void _run();
+	void _publish();
+
+private:
+	TextMoba*   _textMoba;
+	BuildModel  _buildModel;
+	OutputSink  _outputSink;
+
+	SpscQueue<lair::String, COMMAND_QUEUE_SIZE> _commands;
+	SpscQueue<lair::String, OUTPUT_QUEUE_SIZE>  _output;
+
+	ViewModel             _models[3];
+	// Index of the last published model, with FRESH_BIT until acquired.
+	std::atomic<unsigned> _ready;
+	unsigned              _building;
+	unsigned              _reading;
+
+	std::thread             _thread;
+	std::atomic<bool>       _running;
+	std::mutex              _mutex;
+	std::condition_variable _wakeUp;
+};
+
+
+#endif
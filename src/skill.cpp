@@ -24,6 +24,7 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "character.h"
+#include "state_hash.h"
 
 #include "skill.h"
 
@@ -97,6 +98,7 @@ unsigned SkillModel::manaCost(unsigned level) const {
 
 Skill::Skill(SkillModelSP model, unsigned level, CharacterSP character)
     : _model(model)
+    , _slot(0)
     , _level(level)
     , _timeBeforeNextUse(0)
     , _character(character)
@@ -311,6 +313,27 @@ void Skill::useOn(const CharacterVector& chars) {
 }
 
 
+void Skill::setLevel(unsigned level) {
+	character()->_rehash(HASH_SKILL_LEVEL, uint64(_slot) << 32 | _level,
+	                                       uint64(_slot) << 32 | level);
+	_level = level;
+}
+
+
+void Skill::setTimeBeforeNextUse(unsigned time) {
+	character()->_rehash(HASH_SKILL_COOLDOWN, uint64(_slot) << 32 | _timeBeforeNextUse,
+	                                          uint64(_slot) << 32 | time);
+	_timeBeforeNextUse = time;
+}
+
+
+uint64 Skill::computeHash() const {
+	CharacterSP c = character();
+	return c->_hashKey(HASH_SKILL_LEVEL,    uint64(_slot) << 32 | _level)
+	     ^ c->_hashKey(HASH_SKILL_COOLDOWN, uint64(_slot) << 32 | _timeBeforeNextUse);
+}
+
+
 SkillEffect parseSkillEffect(const lair::String& str) {
 	if(str == "none")
 		return NO_EFFECT;
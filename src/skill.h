@@ -125,6 +125,11 @@ public:
 
 	void useOn(const CharacterVector& chars);
 
+	void setLevel(unsigned level);
+	void setTimeBeforeNextUse(unsigned time);
+
+	lair::uint64 computeHash() const;
+
 	template<typename... Args>
 	void print(Args&&... args) const {
 		character()->_textMoba->print(std::forward<Args>(args)...);
@@ -133,6 +138,7 @@ public:
 public:
 	SkillModelSP _model;
 
+	unsigned     _slot;
 	unsigned     _level;
 	unsigned     _timeBeforeNextUse;
 
@@ -0,0 +1,174 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include <lair/core/log.h>
+
+#include "speculator.h"
+
+
+using namespace lair;
+
+
+Speculator::Speculator(TextMoba* textMoba)
+    : _textMoba(textMoba)
+    , _model(&textMoba->simModel())
+    , _time(0)
+    , _threadCount(1)
+    , _pending(false)
+    , _busy(false)
+    , _quit(false)
+    , _cancel(false)
+    , _intentCount(0)
+    , _hits(0)
+    , _misses(0)
+{
+	_thread = std::thread(&Speculator::_run, this);
+}
+
+
+Speculator::~Speculator() {
+	stop();
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_cond.notify_all();
+	_thread.join();
+}
+
+
+void Speculator::start() {
+	stop();
+
+	TextMoba* tm = _textMoba;
+	// Reproducible games must not depend on timing.
+	if(tm->_heroAi != "search" || tm->_searchPlayouts)
+		return;
+
+	_model->capture(tm, _snapshot);
+	_intents.clear();
+	_time        = tm->_searchTime;
+	_threadCount = tm->_searchThreads? tm->_searchThreads:
+	                                   std::max(1u, std::thread::hardware_concurrency());
+
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_pending = true;
+	}
+	_cond.notify_all();
+}
+
+
+void Speculator::stop() {
+	_cancel = true;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_pending = false;
+	_cond.wait(lock, [this] { return !_busy; });
+
+	_cancel = false;
+}
+
+
+bool Speculator::take(unsigned hero, uint64 hash, SimAction& action) {
+	if(_textMoba->_searchPlayouts)
+		return false;
+
+	for(const Intent& intent: _intents) {
+		if(intent.hero == hero && intent.hash == hash) {
+			action = intent.action;
+			_hits += 1;
+			return true;
+		}
+	}
+
+	_misses += 1;
+	return false;
+}
+
+
+void Speculator::_run() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	for(;;) {
+		_cond.wait(lock, [this] { return _pending || _quit; });
+		if(_quit)
+			break;
+
+		_pending = false;
+		_busy    = true;
+		lock.unlock();
+
+		_speculate();
+
+		lock.lock();
+		_busy = false;
+		_cond.notify_all();
+	}
+}
+
+
+void Speculator::_speculate() {
+	int player = _snapshot.slotOf(_snapshot.player);
+	if(player < 0 || _snapshot.result != SIM_RUNNING)
+		return;
+
+	// Most likely first: wait, attack someone here, leave.
+	SimActionVector actions;
+	_model->actions(_snapshot, player, actions);
+	for(SimActionType type: { SIM_WAIT, SIM_ATTACK, SIM_MOVE }) {
+		for(const SimAction& action: actions) {
+			if(_cancel)
+				return;
+			if(action.type == type)
+				_speculate(action);
+		}
+	}
+}
+
+
+void Speculator::_speculate(const SimAction& playerAction) {
+	_state.copyFrom(_snapshot);
+
+	int player = _state.slotOf(_state.player);
+	if(!_model->applyAction(_state, player, playerAction))
+		return;
+
+	int slot = _model->startTurn(_state);
+	while(slot >= 0) {
+		Intent intent;
+		intent.hero = _state.chars[slot].index;
+		intent.hash = _model->stateHash(_state);
+
+		// A cancelled search is weaker than the one the hero would do.
+		bool found = _search.search(*_model, _state, intent.hero, _time, 0,
+		                            _threadCount, &_cancel, intent.action);
+		_search.reset();
+		if(!found || _cancel)
+			return;
+
+		_intents.push_back(intent);
+		_intentCount += 1;
+
+		_model->applyAction(_state, slot, intent.action);
+		slot = _model->resumeTurn(_state, slot);
+	}
+}
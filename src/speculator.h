@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_SPECULATOR_H_
+#define LD41_SPECULATOR_H_
+
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <lair/core/lair.h>
+
+#include "sim_state.h"
+#include "search_hero_ai.h"
+
+
+// Uses the time the player spends typing to precompute the actions of the
+// search heroes. After each turn, a background thread plays the likely
+// player actions (wait, attack, move) on a snapshot of the game and runs the
+// hero searches at each decision point. When a search hero has to play, it
+// takes the precomputed action if its state is exactly the speculated one.
+class Speculator {
+public:
+	struct Intent {
+		unsigned     hero;
+		lair::uint64 hash;
+		SimAction    action;
+	};
+
+	typedef std::vector<Intent> IntentVector;
+
+public:
+	Speculator(TextMoba* textMoba);
+	Speculator(const Speculator&) = delete;
+	~Speculator();
+
+	Speculator& operator=(const Speculator&) = delete;
+
+	// Snapshots the game and starts speculating. Only from the thread that
+	// owns the TextMoba (the simulation thread in windowed mode).
+	void start();
+	// Cancels the speculation and waits for the thread to be idle. Only
+	// from the thread that owns the TextMoba.
+	void stop();
+
+	// Returns the action precomputed for hero in the state with the given
+	// hash, if any. Must be called after stop(), from the thread that owns
+	// the TextMoba.
+	bool take(unsigned hero, lair::uint64 hash, SimAction& action);
+
+	void _run();
+	void _speculate();
+	void _speculate(const SimAction& playerAction);
+
+public:
+	TextMoba*        _textMoba;
+	const SimModel*  _model;
+
+	SimState         _snapshot;
+	SimState         _state;
+	unsigned         _time;
+	unsigned         _threadCount;
+	HeroSearch       _search;
+	IntentVector     _intents;
+
+	std::thread             _thread;
+	std::mutex              _mutex;
+	std::condition_variable _cond;
+	bool                    _pending;
+	bool                    _busy;
+	bool                    _quit;
+	std::atomic<bool>       _cancel;
+
+	// Statistics, for the perf command.
+	std::atomic<unsigned>   _intentCount;
+	unsigned                _hits;
+	unsigned                _misses;
+};
+
+
+#endif
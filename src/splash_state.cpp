@@ -54,7 +54,8 @@ SplashState::SplashState(Game* game)
       _skipInput(nullptr),
 
       _skipTime(1.e20),
-      _nextState(nullptr) {
+      _nextState(nullptr),
+      _loaded(true) {
 
 	_entities.registerComponentManager(&_sprites);
 	_entities.registerComponentManager(&_texts);
@@ -149,6 +150,12 @@ void SplashState::setNextState(GameState* nextState) {
 }
 
 
+void SplashState::setLoadStep(const LoadStepCallback& loadStep) {
+	_loadStep = loadStep;
+	_loaded   = !loadStep;
+}
+
+
 void SplashState::addSplash(const Path& splashImage) {
 	_splashQueue.emplace_back(splashImage);
 }
@@ -200,6 +207,12 @@ void SplashState::updateTick() {
 
 	_skipTime -= float(_loop.tickDuration()) / float(ONE_SEC);
 
+	if(!_loaded) {
+		_loaded = _loadStep();
+		if(_loaded)
+			quit();
+	}
+
 	if (_skipTime <= 0
 	|| _skipInput->justPressed()) {
 		// ESC quits the game.
@@ -208,7 +221,8 @@ void SplashState::updateTick() {
 			_nextState = nullptr;
 		}
 
-		if(!nextSplash())
+		// The next state can not start before it is loaded.
+		if(!nextSplash() && (_loaded || !_nextState))
 			quit();
 	}
 
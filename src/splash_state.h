@@ -24,6 +24,7 @@
 
 
 #include <deque>
+#include <functional>
 
 #include <lair/core/signal.h>
 
@@ -46,6 +47,8 @@ using namespace lair;
 class Game;
 
 typedef std::deque<Path> PathQueue;
+// Does a bit of loading and returns true when done.
+typedef std::function<bool()> LoadStepCallback;
 
 class SplashState : public GameState {
 public:
@@ -61,6 +64,9 @@ public:
 	Game* game();
 
 	void setNextState(GameState* nextState);
+	// The next state is loaded while the splash screen plays, and the
+	// splash ends as soon as it is ready.
+	void setLoadStep(const LoadStepCallback& loadStep);
 	void addSplash(const Path& splashImage);
 	void clearSplash();
 	bool nextSplash();
@@ -94,6 +100,8 @@ protected:
 
 	float       _skipTime;
 	GameState*  _nextState;
+	LoadStepCallback _loadStep;
+	bool        _loaded;
 	PathQueue   _splashQueue;
 	EntityRef   _splash;
 };
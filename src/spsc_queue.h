@@ -0,0 +1,87 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_SPSC_QUEUE_H_
+#define LD41_SPSC_QUEUE_H_
+
+
+#include <atomic>
+
+#include <lair/core/lair.h>
+
+
+// Lock-free queue with one producer thread and one consumer thread. Holds at
+// most Capacity - 1 items; push() fails when it is full.
+template<typename T, unsigned Capacity>
+class SpscQueue {
+public:
+	SpscQueue()
+	    : _head(0)
+	    , _tail(0)
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// Producer only.
+	bool push(T&& value) {
+		unsigned tail = _tail.load(std::memory_order_relaxed);
+		unsigned next = (tail + 1) % Capacity;
+		if(next == _head.load(std::memory_order_acquire))
+			return false;
+
+		_items[tail] = std::move(value);
+		_tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only.
+	bool pop(T& value) {
+		unsigned head = _head.load(std::memory_order_relaxed);
+		if(head == _tail.load(std::memory_order_acquire))
+			return false;
+
+		value = std::move(_items[head]);
+		_head.store((head + 1) % Capacity, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return _head.load(std::memory_order_acquire)
+		    == _tail.load(std::memory_order_acquire);
+	}
+
+private:
+	T _items[Capacity];
+
+	// Padded to sit on different cache lines, as each one is written by a
+	// single thread. No alignas: queues are members of heap allocated
+	// objects, and C++14 new ignores extended alignments.
+	char                  _pad0[64];
+	std::atomic<unsigned> _head;
+	char                  _pad1[64];
+	std::atomic<unsigned> _tail;
+	char                  _pad2[64];
+};
+
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_STATE_HASH_H_
+#define LD41_STATE_HASH_H_
+
+
+#include <cstdio>
+
+#include <lair/core/lair.h>
+
+
+// The state hash is the xor of one key per (object, field, value) triple,
+// Zobrist-style: changing a field updates the hash by xor-ing out the key of
+// the old value and xor-ing in the key of the new one. Keys are computed on
+// the fly by a mixing function instead of looked up in random tables.
+
+enum HashField {
+	HASH_TURN,
+	HASH_WAVE_COUNTER,
+	HASH_RNG,
+	HASH_CLASS,
+	HASH_NODE,
+	HASH_PLACE,
+	HASH_LEVEL,
+	HASH_XP,
+	HASH_HP,
+	HASH_MANA,
+	HASH_DEATH_TIME,
+	HASH_BUFF,
+	HASH_SKILL_LEVEL,
+	HASH_SKILL_COOLDOWN,
+};
+
+// Object id used for the fields that do not belong to a character.
+enum {
+	HASH_GLOBAL = 0xffffffffu,
+};
+
+
+inline lair::uint64 hashMix(lair::uint64 z) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+inline lair::uint64 zobristKey(lair::uint64 object, unsigned field,
+                               lair::uint64 value) {
+	return hashMix(hashMix(value + 0x9e3779b97f4a7c15ull)
+	             ^ (object << 8 | field));
+}
+
+// FNV-1a, stable across platforms unlike std::hash.
+inline lair::uint64 hashString(const lair::String& str) {
+	lair::uint64 hash = 0xcbf29ce484222325ull;
+	for(char c: str)
+		hash = (hash ^ lair::Byte(c)) * 0x100000001b3ull;
+	return hash;
+}
+
+inline lair::String hashToString(lair::uint64 hash) {
+	char buffer[17];
+	std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+	return buffer;
+}
+
+
+#endif
@@ -19,6 +19,9 @@
  */
 
 
+#include <cctype>
+#include <cstring>
+
 #include <lair/core/log.h>
 
 #include "game.h"
@@ -34,7 +37,15 @@
 #include "redshirt_ai.h"
 #include "tower_ai.h"
 #include "hero_ai.h"
+#include "search_hero_ai.h"
 #include "tm_command.h"
+#include "replay.h"
+#include "binary_io.h"
+#include "state_hash.h"
+#include "sim_state.h"
+#include "speculator.h"
+#include "lane_stats.h"
+#include "lane_planner.h"
 
 #include "text_moba.h"
 
@@ -256,43 +267,91 @@ Place placeFromPlaceIndex(unsigned pi) {
 
 
 
+const char TextMoba::saveMagic[8] = { 'l', 'd', '4', '1', 's', 'a', 'v', '\n' };
+
+
 TextMoba::TextMoba(MainState* mainState, Console* console)
     : _mainState(mainState)
     , _console(console)
+    , _consoleSink(console)
+    , _logSink()
+    , _asyncLog(nullptr)
+    , _sinkMask(0)
+    , _messageMask(0)
     , _currentCommand(nullptr)
+    , _commandDepth(0)
+    , _rngState(0)
+    , _replayRecorder(nullptr)
+    , _searchTime(0)
+    , _searchThreads(0)
+    , _searchPlayouts(0)
+    , _searchStats()
+    , _planInterval(0)
+    , _planTravelCost(0)
+    , _planSwitchCost(0)
+    , _aggregateFights(false)
+    , _aggregateMessages(false)
+    , _turn(0)
+    , _nextWaveCounter(0)
+    , _running(false)
+    , _characterHash(0)
+    , _laneStats(std::make_shared<LaneStats>())
 {
 	using namespace std::placeholders;
 
+	addMessageSink(&_consoleSink);
+	addMessageSink(&_logSink);
+
 	_console->setExecCommand(std::bind(&TextMoba::_execCommand, this, _1, false));
 
 	_addCommand<HelpCommand>();
 	_addCommand<InfoCommand>();
 	_addCommand<LookCommand>();
 	_addCommand<DirectionsCommand>();
+	_addCommand<LanesCommand>();
 	_addCommand<WaitCommand>();
 	_addCommand<GoCommand>();
+	_addCommand<GotoCommand>();
 	_addCommand<MoveCommand>();
 	_addCommand<AttackCommand>();
 	_addCommand<UseCommand>();
+	_addCommand<CallCommand>();
+	_addCommand<SaveCommand>();
+	_addCommand<LoadCommand>();
 	_addCommand<RestartCommand>();
+	_addCommand<PerfCommand>();
+	_addCommand<ReloadCommand>();
 }
 
 
 void TextMoba::initialize(const Path& logicPath) {
-	VirtualFile file = _mainState->game()->fileSystem()->file(logicPath);
-
-	Path realPath = file.realPath();
-	if(!realPath.empty()) {
-		Path::IStream in(realPath.native().c_str());
+	_logicPath = logicPath;
+	_readLogic(logicPath, [this, &logicPath](std::istream& in) {
 		_initialize(in, logicPath);
-	}
+	});
+}
 
-	const MemFile* memFile = file.fileBuffer();
-	if(memFile) {
-		String buffer((const char*)memFile->data, memFile->size);
-		std::istringstream in(buffer);
-		_initialize(in, logicPath);
-	}
+
+bool TextMoba::reloadAi() {
+	Variant config;
+	bool parsed = false;
+	_readLogic(_logicPath, [this, &config, &parsed](std::istream& in) {
+		parsed = _parseLogic(in, _logicPath, config);
+	});
+
+	BehaviorTrees trees;
+	if(!parsed || !trees.compile(config.get("ai")))
+		return false;
+
+	// The speculator thread runs the trees of the simulation.
+	if(_speculator)
+		_speculator->stop();
+	_behaviorTrees = trees;
+	_simModel->_behaviorTrees = trees;
+	if(_speculator && _running)
+		_speculator->start();
+
+	return true;
 }
 
 
@@ -306,6 +365,165 @@ Console* TextMoba::console() {
 }
 
 
+ConsoleSink& TextMoba::consoleSink() {
+	return _consoleSink;
+}
+
+
+LogSink& TextMoba::logSink() {
+	return _logSink;
+}
+
+
+void TextMoba::addMessageSink(MessageSink* sink) {
+	_messageSinks.push_back(sink);
+	updateMessageMask();
+}
+
+
+void TextMoba::removeMessageSink(MessageSink* sink) {
+	_messageSinks.erase(std::remove(_messageSinks.begin(), _messageSinks.end(), sink),
+	                    _messageSinks.end());
+	updateMessageMask();
+}
+
+
+void TextMoba::updateMessageMask() {
+	_sinkMask = 0;
+	for(MessageSink* sink: _messageSinks)
+		_sinkMask |= sink->wantedMessages();
+
+	_messageMask = _sinkMask;
+	if(_asyncLog)
+		_messageMask |= _asyncLog->wantedMessages();
+}
+
+
+AsyncLog* TextMoba::asyncLog() {
+	return _asyncLog;
+}
+
+
+void TextMoba::setAsyncLog(AsyncLog* asyncLog) {
+	_asyncLog = asyncLog;
+	updateMessageMask();
+}
+
+
+bool TextMoba::_canMergeReport(const CharacterSP& subject) const {
+	return _turnOutput.aggregate() && _commandDepth
+	    && subject->type() == REDSHIRT;
+}
+
+
+String TextMoba::_reportName(const CharacterSP& character) const {
+	// Redshirts are merged by class, so they are named by their class.
+	if(character->type() == REDSHIRT)
+		return cat(character->className(), "s");
+	return character->name(false);
+}
+
+
+void TextMoba::_dispatchMessage(MessageKind kind, const String& message) {
+	// The console output of a command is sent in one go when it ends.
+	if(kind == MSG_CONSOLE && _commandDepth) {
+		_turnOutput.write(message);
+		return;
+	}
+
+	MessageMask bit = messageBit(kind);
+	for(MessageSink* sink: _messageSinks) {
+		if(sink->wantedMessages() & bit)
+			sink->write(kind, message);
+	}
+}
+
+
+void TextMoba::_flushOutput() {
+	if(_turnOutput.empty())
+		return;
+
+	_outputText.clear();
+	_turnOutput.flush(_outputText);
+
+	MessageMask bit = messageBit(MSG_CONSOLE);
+	for(MessageSink* sink: _messageSinks) {
+		if(sink->wantedMessages() & bit)
+			sink->write(MSG_CONSOLE, _outputText);
+	}
+}
+
+
+void TextMoba::seed(uint64 seed) {
+	_rngState = seed;
+}
+
+
+uint64 TextMoba::rngState() const {
+	return _rngState;
+}
+
+
+void TextMoba::setRngState(uint64 state) {
+	_rngState = state;
+}
+
+
+unsigned TextMoba::random(unsigned range) {
+	// SplitMix64: tiny state, good enough for game logic.
+	_rngState += 0x9e3779b97f4a7c15ull;
+	return ((hashMix(_rngState) >> 32) * range) >> 32;
+}
+
+
+uint64 TextMoba::stateHash() const {
+	return _characterHash
+	     ^ zobristKey(HASH_GLOBAL, HASH_TURN,         _turn)
+	     ^ zobristKey(HASH_GLOBAL, HASH_WAVE_COUNTER, _nextWaveCounter)
+	     ^ zobristKey(HASH_GLOBAL, HASH_RNG,          _rngState);
+}
+
+
+uint64 TextMoba::computeStateHash() const {
+	uint64 hash = zobristKey(HASH_GLOBAL, HASH_TURN,         _turn)
+	            ^ zobristKey(HASH_GLOBAL, HASH_WAVE_COUNTER, _nextWaveCounter)
+	            ^ zobristKey(HASH_GLOBAL, HASH_RNG,          _rngState);
+	for(const CharacterSP& c: _characters)
+		hash ^= c->computeHash();
+	return hash;
+}
+
+
+ReplayRecorder* TextMoba::replayRecorder() {
+	return _replayRecorder;
+}
+
+
+void TextMoba::setReplayRecorder(ReplayRecorder* recorder) {
+	_replayRecorder = recorder;
+}
+
+
+const SimModel& TextMoba::simModel() const {
+	return *_simModel;
+}
+
+
+const BehaviorTrees& TextMoba::behaviorTrees() const {
+	return _behaviorTrees;
+}
+
+
+Speculator* TextMoba::speculator() {
+	return _speculator.get();
+}
+
+
+const LaneStats& TextMoba::laneStats() const {
+	return *_laneStats;
+}
+
+
 unsigned TextMoba::heroNextLevel(unsigned level) const {
 	return _heroNextLevel.at(level);
 }
@@ -357,6 +575,44 @@ MapNodeSP TextMoba::fonxus(Team team) {
 }
 
 
+MapNodeSP TextMoba::findNode(const lair::String& name) {
+	MapNodeSP node = mapNode(name);
+	if(node)
+		return node;
+
+	auto simplify = [](const String& str) {
+		String lower;
+		for(char c: str)
+			lower.push_back(std::tolower(c));
+		if(lower.compare(0, 4, "the ") == 0)
+			lower.erase(0, 4);
+		return lower;
+	};
+
+	String simpleName = simplify(name);
+	for(const MapNodeSP& n: _nodeList) {
+		if(simplify(n->id()) == simpleName || simplify(n->name()) == simpleName)
+			return n;
+	}
+	return nullptr;
+}
+
+
+unsigned TextMoba::distance(Team team, MapNodeSP from, MapNodeSP to) const {
+	if(team > RED || !from || !to)
+		return NO_PATH;
+	return _pathDistance[team][from->_index * _nodeList.size() + to->_index];
+}
+
+
+MapNodeSP TextMoba::nextHop(Team team, MapNodeSP from, MapNodeSP to) const {
+	if(team > RED || !from || !to)
+		return nullptr;
+	unsigned next = _pathNext[team][from->_index * _nodeList.size() + to->_index];
+	return (next != NO_PATH)? _nodeList[next]: nullptr;
+}
+
+
 CharacterClassSP TextMoba::characterClass(const lair::String& id) {
 	auto it = _classes.find(id);
 	if(it == _classes.end())
@@ -421,10 +677,11 @@ CharacterSP TextMoba::spawnCharacter(const lair::String& className, Team team,
 		moveCharacter(character, node);
 	}
 
-	dbgLogger.log("Spawn ", character->teamName(), " ", character->className(),
-	              " ", character->index(), " at ", node? node->name(): "<nowhere>");
+	message(MSG_LOG, "Spawn ", character->teamName(), " ", character->className(),
+	        " ", character->index(), " at ", node? node->name(): "<nowhere>");
 
 	_characters.emplace(character);
+	character->_setHashed(true);
 	++_charIndex;
 
 	return character;
@@ -440,7 +697,7 @@ CharacterSP TextMoba::spawnRedshirt(Team team, Lane lane) {
 	MapNodeSP fonxus = mapNode((team == BLUE)? "bf": "rf");
 	CharacterSP redshirt = spawnCharacter(classes[team], team, fonxus);
 	redshirt->setAi<RedshirtAi>(lane);
-	dbgLogger.info("  RedshirtAi: ", lane);
+	message(MSG_INFO, "  RedshirtAi: ", lane);
 	return redshirt;
 }
 
@@ -457,15 +714,15 @@ void TextMoba::killCharacter(CharacterSP character, CharacterSP attacker) {
 	bool printMessage = character->type() == HERO
 	                 || character->node() == player()->node();
 	if(attacker) {
-		dbgLogger.log(attacker->name(), " killed ", character->name(), ".");
+		message(MSG_LOG, nameOf(attacker), " killed ", nameOf(character), ".");
 		if(printMessage) {
-			print(attacker->name(), " killed ", character->name(), ".");
+			print(nameOf(attacker), " killed ", nameOf(character), ".");
 		}
 	}
 	else {
-		dbgLogger.log(character->debugName(), " killed.");
+		message(MSG_LOG, debugNameOf(character), " killed.");
 		if(printMessage) {
-			print(character->name(), " killed.");
+			print(nameOf(character), " killed.");
 		}
 	}
 
@@ -482,15 +739,21 @@ void TextMoba::killCharacter(CharacterSP character, CharacterSP attacker) {
 
 		moveCharacter(character, nullptr);
 		// +1 because it will be decremented almost instantly.
-		character->_deathTime = _respawnTime[character->_level] + 1;
-		dbgLogger.error(character->debugName(), " death time ", character->deathTime());
+		character->setDeathTime(_respawnTime[character->level()] + 1);
+		message(MSG_DEBUG, debugNameOf(character), " death time ", character->deathTime());
 	}
 	else {
 		if(character->node()) {
 			character->node()->removeCharacter(character);
 			moveCharacter(character, nullptr);
 		}
+		character->_setHashed(false);
 		_characters.erase(character);
+
+		if(character->className() == "tower") {
+			planLanes(BLUE);
+			planLanes(RED);
+		}
 	}
 }
 
@@ -499,20 +762,22 @@ void TextMoba::moveCharacter(CharacterSP character, MapNodeSP dest) {
 	if(player() && character != player() && player()->isAlive()
 	        && character->type() != BUILDING
 	        && character->node() == player()->node()) {
-		print(character->name(), " leaves the area.");
+		report(TurnOutput::ACTION_LEAVE, character, nullptr, 0,
+		       nameOf(character), " leaves the area.");
 	}
 
 	if(character->node()) {
 		character->node()->removeCharacter(character);
 	}
 
-	character->_node = dest;
-	character->_place = character->cClass()->defaultPlace();
+	character->setNode(dest);
+	character->setPlace(character->cClass()->defaultPlace());
 
 	if(player() && character != player() && player()->isAlive()
 	        && character->type() != BUILDING
 	        && character->node() == player()->node()) {
-		print(character->name(false), " enters the area.");
+		report(TurnOutput::ACTION_ENTER, character, nullptr, 0,
+		       nameOf(character, false), " enters the area.");
 	}
 
 	if(dest) {
@@ -524,41 +789,45 @@ void TextMoba::moveCharacter(CharacterSP character, MapNodeSP dest) {
 void TextMoba::placeCharacter(CharacterSP character, Place place) {
 	if(player() && player()->isAlive()
 	        && character->node() == player()->node()) {
-		print(character->name(), " moves to the ", placeName(place), " row.");
+		print(nameOf(character), " moves to the ", placeName(place), " row.");
 	}
-	character->_place = place;
+	character->setPlace(place);
 }
 
 
 void TextMoba::attack(CharacterSP attacker, CharacterSP target) {
 	unsigned damage = attacker->damage();
 
-	dbgLogger.log(attacker->debugName(), " attack ", target->debugName(),
-	              " for ", damage, " damage.");
+	message(MSG_LOG, debugNameOf(attacker), " attack ", debugNameOf(target),
+	        " for ", damage, " damage.");
 
 	if(attacker->node() == player()->node()) {
-		print(attacker->name(), " attack ", target->name(), " for ",
-		      damage, " damage.");
+		report(TurnOutput::ACTION_ATTACK, attacker, target, damage,
+		       nameOf(attacker), " attack ", nameOf(target), " for ",
+		       damage, " damage.");
 	}
 
+	if(attacker == _player)
+		_playerTarget = target;
+
 	dealDamage(target, damage, attacker);
 }
 
 
 void TextMoba::dealDamage(CharacterSP target, unsigned damage, CharacterSP attacker) {
 	if(damage >= target->hp()) {
-		target->_hp = 0;
+		target->setHp(0);
 		killCharacter(target, attacker);
 	}
 	else {
-		target->_hp -= damage;
+		target->setHp(target->hp() - damage);
 	}
 }
 
 
 void TextMoba::healCharacter(CharacterSP target, unsigned amount, CharacterSP /*healer*/) {
 	if(target->isAlive()) {
-		target->_hp = std::min(target->hp() + amount, target->maxHP());
+		target->setHp(std::min(target->hp() + amount, target->maxHP()));
 	}
 }
 
@@ -567,21 +836,21 @@ void TextMoba::useSkillOn(SkillSP skill, const CharacterVector& targets) {
 	CharacterSP character = skill->character();
 
 	if(player()->isAlive() && character->node() == player()->node()) {
-		print(character->name(), " uses ", skill->name(), "...");
+		print(nameOf(character), " uses ", skill->name(), "...");
 	}
 
 	for(CharacterSP c: targets) {
 		_useSkillOn(skill, c);
 	}
-	skill->_timeBeforeNextUse = skill->cooldown() + 1;
+	skill->setTimeBeforeNextUse(skill->cooldown() + 1);
 }
 
 
 void TextMoba::_useSkillOn(SkillSP skill, CharacterSP target) {
 	CharacterSP character = skill->character();
 
-	dbgLogger.log(character->debugName(), " uses skill ", skill->id(), " lvl ", skill->_level,
-	              " on ", target->debugName());
+	message(MSG_LOG, debugNameOf(character), " uses skill ", skill->id(), " lvl ", skill->_level,
+	        " on ", debugNameOf(target));
 
 	bool printMessage = player()->isAlive() && character->node() == player()->node();
 
@@ -596,7 +865,7 @@ void TextMoba::_useSkillOn(SkillSP skill, CharacterSP target) {
 			break;
 		case DAMAGE:
 			if(printMessage) {
-				print("  ", target->name(), " takes ", power, " damage.");
+				print("  ", nameOf(target), " takes ", power, " damage.");
 			}
 
 			// Don't call attack to avoid the "x attack y" message
@@ -606,7 +875,7 @@ void TextMoba::_useSkillOn(SkillSP skill, CharacterSP target) {
 		case HEAL:
 			if(target->hp() != target->maxHP()) {
 				if(printMessage) {
-					print("  ", target->name(), " heal ", power, " hp.");
+					print("  ", nameOf(target), " heal ", power, " hp.");
 				}
 
 				target->heal(power, character);
@@ -615,18 +884,18 @@ void TextMoba::_useSkillOn(SkillSP skill, CharacterSP target) {
 
 		case DOT:
 			if(printMessage) {
-				print("  ", target->name(), " will take ", power, " damage for 3 turns.");
+				print("  ", nameOf(target), " will take ", power, " damage for 3 turns.");
 			}
 
-			target->_buffs.push_back(Buff {3, (int) power, 'd'});
+			target->addBuff(Buff {3, (int) power, 'd'});
 			break;
 
 		case HOT:
 			if(printMessage) {
-				print("  ", target->name(), " regenerates ", power, " hp for 3 turns.");
+				print("  ", nameOf(target), " regenerates ", power, " hp for 3 turns.");
 			}
 
-			target->_buffs.push_back(Buff {3, (int) power, 'h'});
+			target->addBuff(Buff {3, (int) power, 'h'});
 			break;
 		}
 	}
@@ -639,10 +908,10 @@ void TextMoba::grantXp(CharacterSP character, unsigned xp) {
 		return;
 
 	if(character == player()) {
-		print(character->name(), " gains ", xp, " xp.");
+		print(nameOf(character), " gains ", xp, " xp.");
 	}
 
-	character->_xp += xp;
+	character->setXp(character->xp() + xp);
 	if(character->xp() < nextLevelXp)
 		return;
 
@@ -651,17 +920,17 @@ void TextMoba::grantXp(CharacterSP character, unsigned xp) {
 		float hpRatio = float(character->hp()) / float(character->maxHP());
 		float manaRatio = float(character->mana()) / float(character->maxMana());
 
-		character->_level += 1;
-		character->_xp    -= nextLevelXp;
-		print(character->name(), " reaches lvl ", character->level() + 1);
+		character->setLevel(character->level() + 1);
+		character->setXp(character->xp() - nextLevelXp);
+		print(nameOf(character), " reaches lvl ", character->level() + 1);
 
-		character->_hp   = character->maxHP()   * hpRatio;
-		character->_mana = character->maxMana() * manaRatio;
+		character->setHp(  character->maxHP()   * hpRatio);
+		character->setMana(character->maxMana() * manaRatio);
 
-		unsigned skillIndex = character->_level % 3;
+		unsigned skillIndex = character->level() % 3;
 		if(skillIndex < character->skills().size()) {
 			SkillSP skill = character->_skills[skillIndex];
-			skill->_level += 1;
+			skill->setLevel(skill->level() + 1);
 
 			if(character == player()) {
 				print("Your skill \"", skill->name(), "\" reaches level ", skill->level());
@@ -669,20 +938,98 @@ void TextMoba::grantXp(CharacterSP character, unsigned xp) {
 		}
 
 		if(nextLevel(character) == 0)
-			character->_xp = 0;
+			character->setXp(0);
+	}
+}
+
+
+void TextMoba::planLanes(Team team) {
+	Team enemy = enemyTeam(team);
+
+	LanePlan plan;
+	plan.heroCount = 0;
+	for(Lane lane: { TOP, BOT }) {
+		const LaneStats::TeamStats& allies  = _laneStats->lane(lane, team);
+		const LaneStats::TeamStats& enemies = _laneStats->lane(lane, enemy);
+		plan.need[lane] = int(enemies.redshirtHp + enemies.heroHp) - int(allies.redshirtHp);
+	}
+
+	// Same order as the characters, which SimModel follows too.
+	HeroAi* ais[LanePlan::MAX_HEROES];
+	for(const CharacterSP& c: _characters) {
+		if(c->type() != HERO || c->team() != team)
+			continue;
+
+		MapNodeSP node = c->node()? c->node(): fonxus(team);
+		AiSP ai = c->ai();
+		if(!ai || (ai->type() != AI_HERO && ai->type() != AI_SEARCH_HERO)) {
+			// The player goes where they want.
+			if(node->_lane != LaneStats::NO_LANE)
+				plan.need[node->_lane] -= c->maxHP();
+			continue;
+		}
+		if(plan.heroCount == LanePlan::MAX_HEROES)
+			continue;
+
+		HeroAi* heroAi = static_cast<HeroAi*>(ai.get());
+		LanePlan::Hero& hero = plan.heroes[plan.heroCount];
+		hero.strength      = c->maxHP();
+		hero.distance[TOP] = _laneStats->laneDistance(team, TOP, node.get());
+		hero.distance[BOT] = _laneStats->laneDistance(team, BOT, node.get());
+		hero.lane          = heroAi->_lane;
+		ais[plan.heroCount++] = heroAi;
+	}
+
+	plan.solve(_planTravelCost, _planSwitchCost);
+
+	for(unsigned i = 0; i < plan.heroCount; ++i) {
+		if(ais[i]->_lane != plan.heroes[i].lane) {
+			ais[i]->_lane = plan.heroes[i].lane;
+			message(MSG_LOG, debugNameOf(ais[i]->character()), " heads to the ",
+			        laneName(ais[i]->_lane), " lane.");
+		}
+	}
+}
+
+
+unsigned TextMoba::callHeroes(CharacterSP caller) {
+	unsigned count = 0;
+	for(const CharacterSP& c: _characters) {
+		AiSP ai = c->ai();
+		if(c == caller || c->type() != HERO || c->team() != caller->team() || !c->isAlive()
+		        || !ai || (ai->type() != AI_HERO && ai->type() != AI_SEARCH_HERO))
+			continue;
+
+		HeroAi* heroAi = static_cast<HeroAi*>(ai.get());
+		if(heroAi->_status == HeroAi::BACK_TO_BASE)
+			continue;
+
+		heroAi->startPlan(PLAN_FOLLOW, _turn);
+		message(MSG_LOG, debugNameOf(c), " follows ", debugNameOf(caller), ".");
+		count += 1;
 	}
+	return count;
 }
 
 
 void TextMoba::nextTurn() {
+	if(_speculator)
+		_speculator->stop();
+
 	_turn += 1;
 
-	auto cit  = _characters.begin();
-	auto cend = _characters.end();
+	if(_planInterval && _turn % _planInterval == 0) {
+		planLanes(BLUE);
+		planLanes(RED);
+	}
 
 	_nextWaveCounter -= 1;
 
 	// Blue NPC turns
+	_resolveQuietFights(BLUE);
+
+	auto cit  = _characters.begin();
+	auto cend = _characters.end();
 	for(; cit != cend && (*cit)->team() == BLUE; ++cit) {
 		if(*cit != player()) {
 			nextTurn(*cit);
@@ -691,11 +1038,16 @@ void TextMoba::nextTurn() {
 
 	// Blue minion waves.
 	if(_nextWaveCounter == 0) {
-		_console->writeLine("A new batch of blueshirts is leaving the fonxus.");
+		print("A new batch of blueshirts is leaving the fonxus.");
 		spawnRedshirts(BLUE, _redshirtPerLane);
 	}
 
 	// Red NPC turns
+	_resolveQuietFights(RED);
+
+	cit = _characters.begin();
+	while(cit != cend && (*cit)->team() == BLUE)
+		++cit;
 	for(; cit != cend; ++cit) {
 		if(*cit != player()) {
 			nextTurn(*cit);
@@ -704,7 +1056,7 @@ void TextMoba::nextTurn() {
 
 	// Red minion waves.
 	if(_nextWaveCounter == 0) {
-		_console->writeLine("A new batch of redshirts is leaving the fonxus.");
+		print("A new batch of redshirts is leaving the fonxus.");
 		spawnRedshirts(RED, _redshirtPerLane);
 	}
 
@@ -724,21 +1076,40 @@ void TextMoba::nextTurn() {
 	// Player turn
 	nextTurn(player());
 
-	_console->writeLine(cat("End of turn ", _turn));
+	if(onTurnEnd)
+		onTurnEnd();
+
+	print("End of turn ", _turn);
 	execCommand("look");
+
+	if(_speculator)
+		_speculator->start();
 }
 
 
 void TextMoba::nextTurn(CharacterSP character) {
+	if(character->_aggregated) {
+		character->_aggregated = false;
+		return;
+	}
+
+	if(_upkeep(character) && character->ai()) {
+		character->ai()->play();
+	}
+}
+
+
+bool TextMoba::_upkeep(CharacterSP character) {
 	if(character->deathTime()) {
-		character->_deathTime -= 1;
-		dbgLogger.warning(character->debugName(), " death time: ", character->deathTime());
+		character->setDeathTime(character->deathTime() - 1);
+		message(MSG_DEBUG, debugNameOf(character), " death time: ", character->deathTime());
 		if(character->deathTime() == 0) {
-			character->_hp   = character->maxHP();
-			character->_mana = character->maxMana();
+			character->setHp(  character->maxHP());
+			character->setMana(character->maxMana());
 			moveCharacter(character, fonxus(character->team()));
+			planLanes(character->team());
 		}
-		return;
+		return false;
 	}
 
 	// Fonxus regen
@@ -752,7 +1123,7 @@ void TextMoba::nextTurn(CharacterSP character) {
 	if(character->type() == HERO)
 	{
 		character->heal(2);
-		character->_mana = std::min(character->mana() + 1, character->maxMana());
+		character->setMana(std::min(character->mana() + 1, character->maxMana()));
 	}
 
 	BuffVector nb;
@@ -767,26 +1138,93 @@ void TextMoba::nextTurn(CharacterSP character) {
 			character->takeDamage(b.amount);
 			break;
 		default:
-			dbgLogger.warning("Unknown buff type : '", b.type,"'.");
+			message(MSG_WARNING, "Unknown buff type : '", b.type,"'.");
 		}
 
 		if(--b.ticks)
 			nb.push_back(b);
 	}
-	character->_buffs.swap(nb);
+	character->setBuffs(std::move(nb));
 
 	if(!character->isAlive())
-		return;
+		return false;
 
 	// Cooldowns
 	for(SkillSP skill: character->skills()) {
 		if(skill->timeBeforeNextUse() != 0)
-			skill->_timeBeforeNextUse -= 1;
+			skill->setTimeBeforeNextUse(skill->timeBeforeNextUse() - 1);
 	}
 
-	// AI
-	if(character->ai()) {
-		character->ai()->play();
+	return true;
+}
+
+
+// The target kept by the "attack_closest" action of the shirts and towers,
+// or null for the characters that do not fight.
+static CharacterWP* stickyTarget(const CharacterSP& c) {
+	Ai* ai = c->ai().get();
+	if(!ai)
+		return nullptr;
+
+	switch(ai->type()) {
+	case AI_REDSHIRT:
+		return &static_cast<RedshirtAi*>(ai)->_target;
+	case AI_TOWER:
+		return &static_cast<TowerAi*>(ai)->_target;
+	default:
+		return nullptr;
+	}
+}
+
+
+void TextMoba::_resolveQuietFights(Team team) {
+	if(!_aggregateFights)
+		return;
+
+	// Nodes in index order, like SimModel: a tower death replans the lanes.
+	for(const MapNodeSP& node: _nodeList) {
+		bool quiet = true;
+		unsigned counts[3] = { 0, 0, 0 };
+		for(const CharacterSP& c: node->_characters) {
+			quiet = quiet && c->type() != HERO;
+			counts[c->team()] += 1;
+		}
+		if(!quiet || !counts[BLUE] || !counts[RED])
+			continue;
+
+		CharacterVector fighters;
+		for(const CharacterSP& c: node->_characters) {
+			if(c->team() == team)
+				fighters.push_back(c);
+		}
+
+		for(const CharacterSP& c: fighters) {
+			c->_aggregated = true;
+			_upkeep(c);
+		}
+
+		// The "attack_closest" action of the shirts and towers, without
+		// running their behavior trees. The groups only change when someone
+		// dies, as nobody moves.
+		CharacterGroups groups(node.get());
+		for(const CharacterSP& c: fighters) {
+			CharacterWP* sticky = stickyTarget(c);
+			if(!sticky || !c->isAlive() || c->node() != node)
+				continue;
+
+			CharacterSP target = sticky->lock();
+			if(!target || !target->isAlive() ||
+			        groups.distanceBetween(c, target) > c->range()) {
+				target = groups.pickClosestEnemy(c);
+			}
+			if(!target)
+				continue;
+
+			*sticky = target;
+			attack(c, target);
+			if(!target->isAlive())
+				groups = CharacterGroups(node.get());
+		}
 	}
 }
 
@@ -794,12 +1232,17 @@ void TextMoba::nextTurn(CharacterSP character) {
 void TextMoba::restart(const lair::String& className) {
 	_turn = 0;
 	_nextWaveCounter = _firstWaveTime;
+	_running = true;
 
 	for(const auto& pair: _nodes) {
 		pair.second->_characters.clear();
 	}
+	for(CharacterSP c: _characters) {
+		c->_setHashed(false);
+	}
 	_characters.clear();
 	_heroes.clear();
+	_playerTarget.reset();
 
 	// Player *must* have charIndex 0
 	_charIndex = 0;
@@ -819,7 +1262,11 @@ void TextMoba::restart(const lair::String& className) {
 
 	for(unsigned i = 1; i < _heroes.size(); ++i) {
 		CharacterSP c = _heroes[i];
-		c->setAi<HeroAi>((c->className() == "ranger")? TOP: BOT);
+		Lane lane = (c->className() == "ranger")? TOP: BOT;
+		if(_heroAi == "search")
+			c->setAi<SearchHeroAi>(lane);
+		else
+			c->setAi<HeroAi>(lane);
 	}
 
 	for(const auto& pair: _nodes) {
@@ -841,10 +1288,220 @@ void TextMoba::restart(const lair::String& className) {
 
 	// Starts the game with a description of the environement
 	execCommand("look");
+
+	if(_speculator)
+		_speculator->start();
+}
+
+
+bool TextMoba::saveGame(std::ostream& out) const {
+	BinaryWriter writer(&out);
+
+	writer.writeBytes(saveMagic, sizeof(saveMagic));
+	writer.writeUInt(SAVE_VERSION);
+
+	writer.writeUInt(_turn);
+	writer.writeUInt(_nextWaveCounter);
+	writer.writeUInt(_charIndex);
+	writer.writeUInt(_rngState);
+
+	writer.writeUInt(_characters.size());
+	for(const CharacterSP& c: _characters) {
+		writer.writeUInt(c->index());
+		writer.writeString(c->cClass()->id());
+		writer.writeUInt(c->team());
+		writer.writeString(c->node()? c->node()->id(): String());
+		writer.writeUInt(c->place());
+		writer.writeUInt(c->level());
+		writer.writeUInt(c->xp());
+		writer.writeUInt(c->hp());
+		writer.writeUInt(c->mana());
+		writer.writeUInt(c->deathTime());
+
+		writer.writeUInt(c->_buffs.size());
+		for(const Buff& b: c->_buffs) {
+			writer.writeUInt(b.ticks);
+			writer.writeInt(b.amount);
+			writer.writeByte(b.type);
+		}
+
+		writer.writeUInt(c->_skills.size());
+		for(const SkillSP& skill: c->_skills) {
+			writer.writeUInt(skill->level());
+			writer.writeUInt(skill->timeBeforeNextUse());
+		}
+	}
+
+	// AIs come after the characters because they reference each other.
+	for(const CharacterSP& c: _characters) {
+		AiSP ai = c->ai();
+		writer.writeUInt(ai? ai->type() + 1: 0);
+		if(ai)
+			ai->write(writer);
+	}
+
+	writeCharacterRef(writer, _player);
+	writeCharacterRef(writer, _blueFonxus);
+	writeCharacterRef(writer, _redFonxus);
+
+	writer.writeUInt(_heroes.size());
+	for(const CharacterSP& c: _heroes)
+		writeCharacterRef(writer, c);
+	writeCharacterRef(writer, _playerTarget.lock());
+
+	out.flush();
+	return writer.good();
+}
+
+
+bool TextMoba::loadGame(std::istream& in, String* error) {
+	BinaryReader reader(&in);
+
+	auto fail = [error](const char* msg) {
+		if(error)
+			*error = msg;
+		return false;
+	};
+
+	char magic[sizeof(saveMagic)];
+	if(!reader.readBytes(magic, sizeof(magic)) ||
+	   std::memcmp(magic, saveMagic, sizeof(saveMagic)) != 0)
+		return fail("not a saved game");
+	if(reader.readUInt() != SAVE_VERSION)
+		return fail("unsupported save version");
+
+	unsigned turn            = reader.readUInt();
+	unsigned nextWaveCounter = reader.readUInt();
+	unsigned charIndex       = reader.readUInt();
+	uint64   rngState        = reader.readUInt();
+
+	// Everything is read before touching the current game, so that a bad
+	// file leaves it intact.
+	CharacterIndexMap characters;
+	CharacterVector   order;
+
+	uint64 count = reader.readUInt();
+	for(uint64 i = 0; i < count && reader.good(); ++i) {
+		unsigned index = reader.readUInt();
+		CharacterClassSP cc = characterClass(reader.readString());
+		if(!cc)
+			return fail("unknown character class");
+
+		CharacterSP c = std::make_shared<Character>(this, cc, index);
+		c->_team = Team(std::min<uint64>(reader.readUInt(), NEUTRAL));
+
+		String nodeId = reader.readString();
+		if(!nodeId.empty()) {
+			c->_node = mapNode(nodeId);
+			if(!c->_node)
+				return fail("unknown map node");
+		}
+
+		c->_place     = Place(reader.readUInt() & 0x01);
+		c->_level     = reader.readUInt();
+		c->_xp        = reader.readUInt();
+		c->_hp        = reader.readUInt();
+		c->_mana      = reader.readUInt();
+		c->_deathTime = reader.readUInt();
+
+		uint64 buffCount = reader.readUInt();
+		for(uint64 bi = 0; bi < buffCount && reader.good(); ++bi) {
+			Buff b;
+			b.ticks  = reader.readUInt();
+			b.amount = reader.readInt();
+			b.type   = reader.readByte();
+			c->_buffs.push_back(b);
+		}
+
+		for(const String& skillName: cc->skills()) {
+			SkillModelSP sm = skillModel(skillName);
+			if(sm)
+				c->addSkill(sm);
+		}
+		if(reader.readUInt() != c->_skills.size())
+			return fail("skills do not match the gameplay file");
+		for(const SkillSP& skill: c->_skills) {
+			skill->_level             = reader.readUInt();
+			skill->_timeBeforeNextUse = reader.readUInt();
+		}
+
+		characters.emplace(index, c);
+		order.push_back(c);
+	}
+
+	for(const CharacterSP& c: order) {
+		uint64 aiType = reader.readUInt();
+		if(aiType == 0)
+			continue;
+
+		AiSP ai;
+		switch(aiType - 1) {
+		case AI_BASIC:       ai = c->setAi<Ai>();               break;
+		case AI_HERO:        ai = c->setAi<HeroAi>(TOP);        break;
+		case AI_REDSHIRT:    ai = c->setAi<RedshirtAi>(TOP);    break;
+		case AI_TOWER:       ai = c->setAi<TowerAi>();          break;
+		case AI_SEARCH_HERO: ai = c->setAi<SearchHeroAi>(TOP); break;
+		default:
+			return fail("unknown AI type");
+		}
+		ai->read(reader, characters);
+	}
+
+	CharacterSP player     = readCharacterRef(reader, characters);
+	CharacterSP blueFonxus = readCharacterRef(reader, characters);
+	CharacterSP redFonxus  = readCharacterRef(reader, characters);
+
+	CharacterVector heroes;
+	uint64 heroCount = reader.readUInt();
+	for(uint64 i = 0; i < heroCount && reader.good(); ++i)
+		heroes.push_back(readCharacterRef(reader, characters));
+	CharacterSP playerTarget = readCharacterRef(reader, characters);
+
+	if(!reader.good())
+		return fail("truncated or corrupted file");
+	if(!player || !blueFonxus || !redFonxus)
+		return fail("missing player or fonxus");
+
+	// Replace the current game.
+	for(const auto& pair: _nodes) {
+		pair.second->_characters.clear();
+	}
+	for(CharacterSP c: _characters) {
+		c->_setHashed(false);
+	}
+	_characters.clear();
+
+	for(const CharacterSP& c: order) {
+		if(c->node())
+			c->node()->addCharacter(c);
+		_characters.emplace(c);
+		c->_setHashed(true);
+	}
+
+	_turn            = turn;
+	_nextWaveCounter = nextWaveCounter;
+	_charIndex       = charIndex;
+	_rngState        = rngState;
+	_player          = player;
+	_blueFonxus      = blueFonxus;
+	_redFonxus       = redFonxus;
+	_heroes.swap(heroes);
+	_playerTarget    = playerTarget;
+	_running         = true;
+
+	if(_speculator)
+		_speculator->start();
+
+	return true;
 }
 
 
 void TextMoba::gameOver(bool win) {
+	_running = false;
+
+	if(onGameOver)
+		onGameOver(win);
+
 	print("");
 	if(win) {
 		print("CONGRATULATION ! You destroyed the enemy Fonxus.");
@@ -869,6 +1526,21 @@ void TextMoba::gameOver(bool win) {
 }
 
 
+StringVector TextMoba::classImages() const {
+	StringVector images;
+	for(const auto& cClass: _classes) {
+		if(!cClass.second->_image.empty())
+			images.push_back(cClass.second->_image);
+	}
+	return images;
+}
+
+
+bool TextMoba::isRunning() const {
+	return _running;
+}
+
+
 const TextMoba::TMCommandList& TextMoba::commands() const {
 	return _commands;
 }
@@ -887,7 +1559,7 @@ void TextMoba::_addCommand(TMCommandSP command) {
 
 	for(const String& id: command->names()) {
 		_commandMap.emplace(id, command.get());
-		dbgLogger.info("Register command \"", id, "\"");
+		message(MSG_INFO, "Register command \"", id, "\"");
 	}
 }
 
@@ -899,9 +1571,32 @@ bool TextMoba::execCommand(const lair::String& command) {
 
 bool TextMoba::_execCommand(const String& command, bool internal) {
 	if(!internal) {
-		dbgLogger.log("Exec: ", command);
+		message(MSG_LOG, "Exec: ", command);
+	}
+
+	// Only record what the player typed, not commands issued by the game.
+	bool record = _replayRecorder && !internal && _commandDepth == 0;
+	if(record) {
+		_replayRecorder->recordCommand(command);
+	}
+
+	_commandDepth += 1;
+	bool result = _parseAndExecCommand(command, internal);
+	_commandDepth -= 1;
+
+	if(_commandDepth == 0) {
+		_flushOutput();
+	}
+
+	if(record) {
+		_replayRecorder->endCommand();
 	}
 
+	return result;
+}
+
+
+bool TextMoba::_parseAndExecCommand(const String& command, bool internal) {
 	StringVector args;
 
 	auto it  = command.begin();
@@ -929,10 +1624,13 @@ bool TextMoba::_execCommand(const String& command, bool internal) {
 	                           this->command(args[0]);
 
 	if(!tmCommand) {
-		console()->writeLine(cat("Command \"", args[0], "\" do not exists. Type \"h\" for help."));
+		print("Command \"", args[0], "\" do not exists. Type \"h\" for help.");
 	}
 	else if(internal) {
-		tmCommand->exec(args);
+		// Commands issued by the game may still wait for an answer, like
+		// restart asking for a class.
+		if(!tmCommand->exec(args))
+			_currentCommand = tmCommand;
 	}
 	else {
 		_currentCommand = tmCommand;
@@ -945,36 +1643,97 @@ bool TextMoba::_execCommand(const String& command, bool internal) {
 }
 
 
-void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
-	// Cleanup
+bool TextMoba::_readLogic(const Path& logicPath,
+                          const std::function<void(std::istream&)>& read) {
+	if(!_mainState) {
+		// Headless: no virtual file system, read straight from disk.
+		Path::IStream in(logicPath.native().c_str());
+		if(!in.good()) {
+			dbgLogger.error("Unable to read \"", logicPath.utf8String(), "\".");
+			return false;
+		}
+		read(in);
+		return true;
+	}
 
-	_heroes.clear();
+	VirtualFile file = _mainState->game()->fileSystem()->file(logicPath);
+
+	bool found = false;
+	Path realPath = file.realPath();
+	if(!realPath.empty()) {
+		Path::IStream in(realPath.native().c_str());
+		read(in);
+		found = true;
+	}
+
+	const MemFile* memFile = file.fileBuffer();
+	if(memFile) {
+		String buffer((const char*)memFile->data, memFile->size);
+		std::istringstream in(buffer);
+		read(in);
+		found = true;
+	}
 
+	return found;
+}
 
-	// Parse ldl
 
+bool TextMoba::_parseLogic(std::istream& in, const lair::Path& logicPath,
+                           Variant& config) {
 	ErrorList errors;
 	LdlParser parser(&in, logicPath.utf8String(), &errors, LdlParser::CTX_MAP);
 
-	Variant config;
-	if(!ldlRead(parser, config)) {
+	bool ok = ldlRead(parser, config);
+	if(!ok) {
 		dbgLogger.error("Failed to load gameplay data from \"",
 		                logicPath.utf8String(), "\"");
 		errors.log(dbgLogger);
 	}
 	errors.log(dbgLogger);
 
+	return ok;
+}
+
+
+void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
+	// Cleanup
+
+	_heroes.clear();
+	_playerTarget.reset();
+
+
+	// Parse ldl
+
+	Variant config;
+	_parseLogic(in, logicPath, config);
+
 	// Read gameplay.ldl
 
 	Variant motd = config.get("motd");
 	if(motd.isString()) {
-		_console->writeLine(motd.asString());
+		print(motd.asString());
 	}
 
 	_firstWaveTime   = getInt(config, "first_wave_time");
 	_waveTime        = getInt(config, "wave_time");
 	_redshirtPerLane = getInt(config, "redshirt_per_lane");
 
+	_heroAi          = getString(config, "hero_ai", "scripted");
+	_searchTime      = getInt(config, "search_time", 20);
+	_searchThreads   = getInt(config, "search_threads", 0);
+	_searchPlayouts  = getInt(config, "search_playouts", 500);
+
+	_planInterval    = getInt(config, "plan_interval", 10);
+	_planTravelCost  = getInt(config, "plan_travel_cost", 10);
+	_planSwitchCost  = getInt(config, "plan_switch_cost", 50);
+
+	_aggregateFights = getInt(config, "aggregate_fights", 0);
+	_aggregateMessages = getInt(config, "aggregate_messages", 0);
+	_turnOutput.setAggregate(_aggregateMessages);
+
+	if(!_behaviorTrees.compile(config.get("ai")))
+		dbgLogger.error("Invalid behavior trees.");
+
 	_heroNextLevel   = getClassStats(config, "hero_next_level");
 	_heroXpWorth     = getClassStats(config, "hero_xp_worth");
 	_redshirtXpWorth = getClassStats(config, "redshirt_xp_worth");
@@ -990,7 +1749,9 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 
 			MapNodeSP node = std::make_shared<MapNode>();
 
+			node->_textMoba = this;
 			node->_id = id;
+			node->_index = 0;
 
 			const Variant& nameVar = obj.get("name");
 			if(nameVar.isString())
@@ -999,9 +1760,6 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 				dbgLogger.error("Node without name");
 
 			node->_images = getStringList(obj, "images");
-			for(const String& img: node->_images) {
-				_mainState->loader()->load<ImageLoader>(img);
-			}
 
 			const Variant& posVar = obj.get("position");
 			if(posVar.isVarList() && posVar.asVarList().size() == 2) {
@@ -1014,6 +1772,15 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 			node->_tower  = getString(obj, "tower");
 			node->_fonxus = getString(obj, "fonxus");
 
+			String lane = getString(obj, "lane");
+			node->_lane = LaneStats::NO_LANE;
+			if(lane == laneName(TOP))
+				node->_lane = TOP;
+			else if(lane == laneName(BOT))
+				node->_lane = BOT;
+			else if(lane.size())
+				dbgLogger.error("Node ", id, ": invalid lane \"", lane, "\"");
+
 			_nodes.emplace(node->id(), node);
 		}
 	}
@@ -1059,6 +1826,9 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 		dbgLogger.error("Expected \"paths\" VarList.");
 	}
 
+	_computePaths();
+	_laneStats->initialize(this);
+
 	const Variant& classes = config.get("classes");
 	if(classes.isVarMap()) {
 		for(const auto& pair: classes.asVarMap()) {
@@ -1094,9 +1864,6 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 			cClass->_skills    = getStringList(obj, "skills");
 
 			cClass->_image     = getString(obj, "image");
-			if(cClass->_image.size()) {
-				_mainState->loader()->load<ImageLoader>(cClass->_image);
-			}
 
 			_classes.emplace(cClass->id(), cClass);
 		}
@@ -1186,6 +1953,81 @@ void TextMoba::_initialize(std::istream& in, const lair::Path& logicPath) {
 		}
 	}
 
+	_speculator.reset();
+	_simModel = std::make_shared<SimModel>();
+	_simModel->initialize(this);
+	if(getInt(config, "speculate", 1)) {
+		_speculator = std::make_shared<Speculator>(this);
+	}
+
 	// Setup
-	_execCommand("restart");
+	_execCommand("restart", true);
+}
+
+
+void TextMoba::_computePaths() {
+	_nodeList.clear();
+	for(const auto& pair: _nodes)
+		_nodeList.push_back(pair.second);
+	std::sort(_nodeList.begin(), _nodeList.end(),
+	          [](const MapNodeSP& n0, const MapNodeSP& n1) {
+		return n0->id() < n1->id();
+	});
+
+	unsigned count = _nodeList.size();
+	for(unsigned i = 0; i < count; ++i)
+		_nodeList[i]->_index = i;
+
+	// Neighbors sorted by index, so that ties are always broken the same way.
+	std::vector<std::vector<unsigned>> neighbors(count);
+	for(unsigned i = 0; i < count; ++i) {
+		for(const auto& path: _nodeList[i]->paths())
+			neighbors[i].push_back(path.first->_index);
+		std::sort(neighbors[i].begin(), neighbors[i].end());
+	}
+
+	std::vector<unsigned> queue;
+	queue.reserve(count);
+	for(Team team: { BLUE, RED }) {
+		MapNodeSP enemyFonxus = fonxus(enemyTeam(team));
+		unsigned forbidden = enemyFonxus? enemyFonxus->_index: count;
+
+		std::vector<uint16>& dist = _pathDistance[team];
+		std::vector<uint16>& next = _pathNext[team];
+		dist.assign(count * count, NO_PATH);
+		next.assign(count * count, NO_PATH);
+
+		for(unsigned to = 0; to < count; ++to) {
+			// Breadth-first search from the destination. The graph is not
+			// directed.
+			dist[to * count + to] = 0;
+			queue.clear();
+			queue.push_back(to);
+			for(unsigned qi = 0; qi < queue.size(); ++qi) {
+				unsigned n = queue[qi];
+				if(n == forbidden && n != to)
+					continue;
+				for(unsigned m: neighbors[n]) {
+					if(dist[m * count + to] == NO_PATH) {
+						dist[m * count + to] = dist[n * count + to] + 1;
+						queue.push_back(m);
+					}
+				}
+			}
+
+			for(unsigned from = 0; from < count; ++from) {
+				unsigned d = dist[from * count + to];
+				if(from == to || d == NO_PATH)
+					continue;
+				for(unsigned m: neighbors[from]) {
+					if(m == forbidden && m != to)
+						continue;
+					if(dist[m * count + to] + 1u == d) {
+						next[from * count + to] = m;
+						break;
+					}
+				}
+			}
+		}
+	}
 }
@@ -32,10 +32,17 @@
 #include <lair/core/parse.h>
 
 #include "console.h"
+#include "message_sink.h"
+#include "turn_output.h"
+#include "async_log.h"
+#include "behavior_tree.h"
 
 
 class MainState;
 class Console;
+class ReplayRecorder;
+class BinaryWriter;
+class BinaryReader;
 
 
 enum Team {
@@ -68,6 +75,9 @@ class SkillModel;
 class Skill;
 class Ai;
 class TMCommand;
+class SimModel;
+class Speculator;
+class LaneStats;
 class TextMoba;
 
 typedef std::shared_ptr<MapNode>         MapNodeSP;
@@ -80,6 +90,9 @@ typedef std::shared_ptr<SkillModel>      SkillModelSP;
 typedef std::shared_ptr<Skill>           SkillSP;
 typedef std::shared_ptr<Ai>              AiSP;
 typedef std::shared_ptr<TMCommand>       TMCommandSP;
+typedef std::shared_ptr<SimModel>        SimModelSP;
+typedef std::shared_ptr<Speculator>      SpeculatorSP;
+typedef std::shared_ptr<LaneStats>       LaneStatsSP;
 
 
 typedef std::vector<int>          IntVector;
@@ -97,6 +110,21 @@ typedef std::set<CharacterSP, CharacterOrder> CharacterSet;
 
 typedef std::vector<SkillSP> SkillVector;
 
+typedef std::unordered_map<unsigned, CharacterSP> CharacterIndexMap;
+
+
+// Tree search statistics, shown by the perf command. Times are in
+// microseconds.
+struct SearchStats {
+	lair::uint64 searches;
+	lair::uint64 playouts;
+	lair::uint64 time;
+	unsigned     lastPlayouts;
+	unsigned     lastTime;
+	unsigned     lastNodes;
+	unsigned     threads;
+};
+
 
 const lair::String& teamName(Team team);
 const lair::String& placeName(Place place);
@@ -113,14 +141,66 @@ class TextMoba {
 public:
 	typedef std::vector<TMCommandSP> TMCommandList;
 
+	// Reads the rules and the game state to build its own copy.
+	friend class SimModel;
+	friend class LaneStats;
+
+	typedef std::function<void(bool)> GameOverCallback;
+	typedef std::function<void()>     TurnCallback;
+
+	enum {
+		SAVE_VERSION = 2,
+		NO_PATH      = 0xffff,
+	};
+
+	static const char saveMagic[8];
+
 public:
 	TextMoba(MainState* mainState, Console* console);
 
 	void initialize(const lair::Path& logicPath);
+	// Reads the "ai" section of the gameplay file again, so that behavior
+	// trees can be tuned while playing.
+	bool reloadAi();
 
 	MainState* mainState();
 	Console* console();
 
+	ConsoleSink& consoleSink();
+	LogSink& logSink();
+
+	void addMessageSink(MessageSink* sink);
+	void removeMessageSink(MessageSink* sink);
+	void updateMessageMask();
+
+	AsyncLog* asyncLog();
+	void setAsyncLog(AsyncLog* asyncLog);
+
+	inline bool wants(MessageKind kind) const {
+		return _messageMask & messageBit(kind);
+	}
+
+	void seed(lair::uint64 seed);
+	lair::uint64 rngState() const;
+	void setRngState(lair::uint64 state);
+
+	// Returns a number in [0, range). Game logic must use this instead of
+	// rand() to stay deterministic, which replays rely on.
+	unsigned random(unsigned range);
+
+	// Hash of the whole game state, updated incrementally as the state
+	// changes. computeStateHash() recomputes it from scratch.
+	lair::uint64 stateHash() const;
+	lair::uint64 computeStateHash() const;
+
+	ReplayRecorder* replayRecorder();
+	void setReplayRecorder(ReplayRecorder* recorder);
+
+	// Forward model of the game rules, for AI lookahead.
+	const SimModel& simModel() const;
+	// Precomputes the search heroes actions between turns. May be null.
+	Speculator* speculator();
+
 	unsigned heroNextLevel(unsigned level) const;
 	unsigned heroXpWorth(unsigned level) const;
 	unsigned redshirtXpWorth(unsigned level) const;
@@ -131,7 +211,19 @@ public:
 
 	MapNodeSP mapNode(const lair::String& id);
 	MapNodeSP fonxus(Team team);
+	// Finds a node by id or by name, ignoring case and a leading "the".
+	MapNodeSP findNode(const lair::String& name);
+
+	// Shortest paths, precomputed when the map is loaded. A team never walks
+	// through the enemy fonxus. Returns NO_PATH / null if there is no path.
+	unsigned distance(Team team, MapNodeSP from, MapNodeSP to) const;
+	MapNodeSP nextHop(Team team, MapNodeSP from, MapNodeSP to) const;
+	// Lane pressure aggregates, kept up to date as characters change.
+	const LaneStats& laneStats() const;
+	const BehaviorTrees& behaviorTrees() const;
 	CharacterClassSP characterClass(const lair::String& id);
+	// The images of the classes, for the window to load.
+	StringVector classImages() const;
 	const CharacterSet& characters() const;
 	CharacterSP player();
 	SkillModelSP skillModel(const lair::String id);
@@ -160,11 +252,31 @@ public:
 
 	void grantXp(CharacterSP character, unsigned xp);
 
+	// Reassigns the lanes of the team AI heroes, see LanePlan.
+	void planLanes(Team team);
+	// Allied AI heroes follow the caller for a few turns, see PLAN_FOLLOW.
+	// Returns the number of heroes that answered.
+	unsigned callHeroes(CharacterSP caller);
+
 	void nextTurn();
 	void nextTurn(CharacterSP character);
+	// Start of turn effects. Returns false if the character can't play.
+	bool _upkeep(CharacterSP character);
+	// Plays at once the turn of the team shirts and towers on the nodes
+	// where they fight with no hero around, if _aggregateFights is set.
+	// Each of them attacks like with the "attack_closest" action, only
+	// the behavior trees are skipped.
+	void _resolveQuietFights(Team team);
 
 	void restart(const lair::String& className);
+
+	// Save / load the whole game state in a compact binary format. The
+	// gameplay file must be the same.
+	bool saveGame(std::ostream& out) const;
+	bool loadGame(std::istream& in, lair::String* error = nullptr);
 	void gameOver(bool win);
+	// False once the game is over, until the next restart.
+	bool isRunning() const;
 
 	const TMCommandList& commands() const;
 	TMCommand* command(const lair::String& name) const;
@@ -178,12 +290,60 @@ public:
 
 	bool execCommand(const lair::String& command);
 	bool _execCommand(const lair::String& command, bool internal = false);
+	bool _parseAndExecCommand(const lair::String& command, bool internal);
+
+	// Arguments are only formatted if a sink wants this kind of message. Use
+	// nameOf() / debugNameOf() instead of Character::name() / debugName().
+	template<typename... Args>
+	inline void message(MessageKind kind, Args&&... args) {
+		if(kind < LD41_MIN_LOG_LEVEL || !wants(kind))
+			return;
+
+		if(_asyncLog && _asyncLog->wants(kind)) {
+			_asyncLog->write(kind, args...);
+		}
+		if(_sinkMask & messageBit(kind)) {
+			_dispatchMessage(kind, lair::cat(std::forward<Args>(args)...));
+		}
+	}
 
 	template<typename... Args>
 	inline void print(Args&&... args) {
-		console()->writeLine(lair::cat(std::forward<Args>(args)...));
+		message(MSG_CONSOLE, std::forward<Args>(args)...);
+	}
+
+	// Like print(), but the line may be merged with the previous one if it
+	// reports the same action by redshirts of the same class, see
+	// _aggregateMessages.
+	template<typename... Args>
+	inline void report(TurnOutput::Action action, const CharacterSP& subject,
+	                   const CharacterSP& object, unsigned value, Args&&... args) {
+		if(MSG_CONSOLE < LD41_MIN_LOG_LEVEL || !wants(MSG_CONSOLE)
+		        || !_canMergeReport(subject)) {
+			print(std::forward<Args>(args)...);
+			return;
+		}
+
+		if(_asyncLog && _asyncLog->wants(MSG_CONSOLE)) {
+			_asyncLog->write(MSG_CONSOLE, args...);
+		}
+		if(_sinkMask & messageBit(MSG_CONSOLE)) {
+			_turnOutput.report(action, _reportName(subject),
+			                   object? _reportName(object): lair::String(),
+			                   value, lair::cat(std::forward<Args>(args)...));
+		}
 	}
 
+	bool _canMergeReport(const CharacterSP& subject) const;
+	lair::String _reportName(const CharacterSP& character) const;
+	void _dispatchMessage(MessageKind kind, const lair::String& message);
+	void _flushOutput();
+
+public:
+	GameOverCallback onGameOver;
+	// Called at the end of each turn, after the player turn.
+	TurnCallback     onTurnEnd;
+
 private:
 	typedef std::unordered_map<lair::String, MapNodeSP>        NodeMap;
 	typedef std::unordered_map<lair::String, TMCommand*>       TMCommandMap;
@@ -191,17 +351,44 @@ private:
 	typedef std::unordered_map<lair::String, SkillModelSP>     SkillModelMap;
 
 private:
+	bool _readLogic(const lair::Path& logicPath,
+	                const std::function<void(std::istream&)>& read);
+	bool _parseLogic(std::istream& in, const lair::Path& logicPath,
+	                 lair::Variant& config);
 	void _initialize(std::istream& in, const lair::Path& logicPath);
+	void _computePaths();
 
 private:
 	MainState*  _mainState;
 	Console*    _console;
 
+	ConsoleSink       _consoleSink;
+	LogSink           _logSink;
+	MessageSinkVector _messageSinks;
+	AsyncLog*         _asyncLog;
+	MessageMask       _sinkMask;
+	MessageMask       _messageMask;
+	// Console output of the running command, sent when it ends.
+	TurnOutput        _turnOutput;
+	lair::String      _outputText;
+
 	TMCommandList _commands;
 	TMCommandMap  _commandMap;
 	TMCommand*    _currentCommand;
+	unsigned      _commandDepth;
+
+	lair::uint64    _rngState;
+	ReplayRecorder* _replayRecorder;
+	SimModelSP      _simModel;
+	SpeculatorSP    _speculator;
+	lair::Path      _logicPath;
+	BehaviorTrees   _behaviorTrees;
 
 	NodeMap       _nodes;
+	// Indexed by MapNode::_index, sorted by id.
+	std::vector<MapNodeSP>    _nodeList;
+	std::vector<lair::uint16> _pathDistance[2];
+	std::vector<lair::uint16> _pathNext[2];
 	ClassMap      _classes;
 	SkillModelMap _skillModels;
 
@@ -223,10 +410,41 @@ public:
 
 	IntVector _respawnTime;
 
+	// "scripted" or "search".
+	lair::String _heroAi;
+	// Per hero and per turn. If _searchPlayouts is not 0, the search is
+	// bounded by playouts instead of time and becomes deterministic.
+	unsigned     _searchTime;
+	unsigned     _searchThreads;
+	unsigned     _searchPlayouts;
+	SearchStats  _searchStats;
+
+	// Hero lanes are planned every _planInterval turns (never if 0) and
+	// when a tower dies or a hero respawns. Costs are in hp.
+	unsigned     _planInterval;
+	unsigned     _planTravelCost;
+	unsigned     _planSwitchCost;
+
+	// Fights nobody watches are resolved per node and not per character:
+	// each side sums the damage of its shirts and towers and focuses it on
+	// the enemy rows, in order. No randomness is involved.
+	bool         _aggregateFights;
+
+	// Consecutive console lines reporting the same action by redshirts of
+	// the same class during a command are merged into one.
+	bool         _aggregateMessages;
+
 	unsigned _turn;
 	unsigned _nextWaveCounter;
+	bool     _running;
+
+	// Xor of Character::computeHash() for all characters in the game.
+	lair::uint64 _characterHash;
+	LaneStatsSP  _laneStats;
 
 	CharacterVector _heroes;
+	// Last character attacked by the player, that following heroes attack.
+	CharacterWP     _playerTarget;
 
 	StringMap _infoTopics;
 };
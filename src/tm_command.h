@@ -38,7 +38,7 @@ public:
 
 	template<typename... Args>
 	inline void print(Args&&... args) const {
-		_textMoba->console()->writeLine(lair::cat(std::forward<Args>(args)...));
+		_textMoba->print(std::forward<Args>(args)...);
 	}
 
 	TextMoba* tm();
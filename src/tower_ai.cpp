@@ -24,6 +24,7 @@
 #include "map_node.h"
 #include "character_class.h"
 #include "character.h"
+#include "binary_io.h"
 
 #include "tower_ai.h"
 
@@ -37,29 +38,27 @@ TowerAi::TowerAi(CharacterSP character)
 }
 
 
+AiType TowerAi::type() const {
+	return AI_TOWER;
+}
+
+
 void TowerAi::play() {
 	CharacterSP c = character();
 
 	if(!c || !c->isAlive())
 		return;
 
-//	dbgLogger.log(c->debugName(), " turn:");
+	AiAgent agent(c, &_target);
+	c->_textMoba->behaviorTrees().run(BT_TOWER, agent);
+}
 
-	Team enemy = c->enemyTeam();
 
-	CharacterGroups groups = c->node()->characterGroups();
-	if(groups.count(enemy)) {
-		CharacterSP target = _target.lock();
+void TowerAi::write(BinaryWriter& writer) const {
+	writeCharacterRef(writer, _target.lock());
+}
 
-		if(!target || !target->isAlive() ||
-		        groups.distanceBetween(c, target) > c->range()) {
-			target = groups.pickClosestEnemy(c);
-		}
 
-		if(target) {
-			_target = target;
-//			dbgLogger.info("  Attack ", target->debugName());
-			c->attack(target);
-		}
-	}
+void TowerAi::read(BinaryReader& reader, const CharacterIndexMap& characters) {
+	_target = readCharacterRef(reader, characters);
 }
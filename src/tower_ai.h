@@ -32,8 +32,13 @@ class TowerAi : public Ai {
 public:
 	TowerAi(CharacterSP character);
 
+	virtual AiType type() const override;
+
 	virtual void play() override;
 
+	virtual void write(BinaryWriter& writer) const override;
+	virtual void read(BinaryReader& reader, const CharacterIndexMap& characters) override;
+
 public:
 	CharacterWP _target;
 };
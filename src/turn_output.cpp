@@ -0,0 +1,114 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#include "turn_output.h"
+
+
+using namespace lair;
+
+
+TurnOutput::TurnOutput()
+    : _aggregate(false)
+    , _size(0)
+{
+}
+
+
+bool TurnOutput::aggregate() const {
+	return _aggregate;
+}
+
+
+void TurnOutput::setAggregate(bool aggregate) {
+	_aggregate = aggregate;
+}
+
+
+bool TurnOutput::empty() const {
+	return _size == 0;
+}
+
+
+void TurnOutput::write(const String& line) {
+	Entry& entry = _push();
+	entry.isReport = false;
+	entry.line     = line;
+}
+
+
+void TurnOutput::report(Action action, const String& subjects,
+                        const String& object, unsigned value,
+                        const String& line) {
+	if(_aggregate && _size) {
+		Entry& last = _entries[_size - 1];
+		if(last.isReport && last.action == action
+		        && last.subjects == subjects && last.object == object) {
+			last.count += 1;
+			last.total += value;
+			return;
+		}
+	}
+
+	Entry& entry = _push();
+	entry.isReport = true;
+	entry.action   = action;
+	entry.line     = line;
+	entry.subjects = subjects;
+	entry.object   = object;
+	entry.count    = 1;
+	entry.total    = value;
+}
+
+
+void TurnOutput::flush(String& out) {
+	for(unsigned i = 0; i < _size; ++i) {
+		const Entry& entry = _entries[i];
+		if(i)
+			out.push_back('\n');
+
+		if(!entry.isReport || entry.count == 1) {
+			out.append(entry.line);
+			continue;
+		}
+
+		switch(entry.action) {
+		case ACTION_ATTACK:
+			out.append(cat(entry.count, " ", entry.subjects, " attack ", entry.object,
+			               " for ", entry.total, " total damage."));
+			break;
+		case ACTION_ENTER:
+			out.append(cat(entry.count, " ", entry.subjects, " enter the area."));
+			break;
+		case ACTION_LEAVE:
+			out.append(cat(entry.count, " ", entry.subjects, " leave the area."));
+			break;
+		}
+	}
+
+	_size = 0;
+}
+
+
+TurnOutput::Entry& TurnOutput::_push() {
+	if(_size == _entries.size())
+		_entries.emplace_back();
+	return _entries[_size++];
+}
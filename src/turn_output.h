@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2018 the authors (see AUTHORS)
+ *
+ *  This file is part of Draklia's ld41.
+ *
+ *  lair is free software: you can redistribute it and/or modify it
+ *  under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  lair is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+#ifndef LD41_TURN_OUTPUT_H_
+#define LD41_TURN_OUTPUT_H_
+
+
+#include <vector>
+
+#include <lair/core/lair.h>
+
+
+// Console output collected while a command runs, including the turns it
+// plays, and sent to the console at once. Consecutive reports of the same
+// action by characters of the same class can be merged into one line:
+// "4 redshirts attack blueshirts for 32 total damage."
+class TurnOutput {
+public:
+	enum Action {
+		ACTION_ATTACK,
+		ACTION_ENTER,
+		ACTION_LEAVE,
+	};
+
+public:
+	TurnOutput();
+
+	bool aggregate() const;
+	void setAggregate(bool aggregate);
+
+	bool empty() const;
+
+	void write(const lair::String& line);
+	// subjects is the plural of the class doing the action, object the
+	// target of the action (if any) and value its amount. line is used if
+	// the report is not merged.
+	void report(Action action, const lair::String& subjects,
+	            const lair::String& object, unsigned value,
+	            const lair::String& line);
+
+	// Appends the collected lines to out, one per line, and clears them.
+	void flush(lair::String& out);
+
+private:
+	struct Entry {
+		bool         isReport;
+		Action       action;
+		lair::String line;
+		lair::String subjects;
+		lair::String object;
+		unsigned     count;
+		unsigned     total;
+	};
+	typedef std::vector<Entry> EntryVector;
+
+private:
+	Entry& _push();
+
+private:
+	bool        _aggregate;
+	// Entries are reused from one command to the next, only the first
+	// _size are in use.
+	EntryVector _entries;
+	unsigned    _size;
+};
+
+
+#endif
@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+##
+##  Copyright (C) 2018 the authors (see AUTHORS)
+##
+##  This file is part of Draklia's ld41.
+##
+##  lair is free software: you can redistribute it and/or modify it
+##  under the terms of the GNU General Public License as published by
+##  the Free Software Foundation, either version 3 of the License, or
+##  (at your option) any later version.
+##
+##  lair is distributed in the hope that it will be useful, but
+##  WITHOUT ANY WARRANTY; without even the implied warranty of
+##  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+##  General Public License for more details.
+##
+##  You should have received a copy of the GNU General Public License
+##  along with lair.  If not, see <http://www.gnu.org/licenses/>.
+##
+
+"""Pack images into a texture atlas.
+
+Writes <name>.png and <name>.ldl in the assets directory. The ldl file
+lists, for each packed image, its rectangle in the atlas in pixels from
+the top-left corner. Each image is surrounded by a copy of its border so
+that bilinear filtering does not bleed from its neighbours.
+
+Usage: pack_atlas.py [-d assets_dir] name image...
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+
+PNG_SIGNATURE = b'\x89PNG\r\n\x1a\n'
+MAX_SIZE = 4096
+
+
+class Image:
+	def __init__(self, width, height, rows=None):
+		self.width  = width
+		self.height = height
+		# One bytearray of RGBA pixels per row.
+		self.rows = rows or [ bytearray(width * 4) for _ in range(height) ]
+
+
+def paeth(a, b, c):
+	p = a + b - c
+	pa = abs(p - a)
+	pb = abs(p - b)
+	pc = abs(p - c)
+	if pa <= pb and pa <= pc:
+		return a
+	if pb <= pc:
+		return b
+	return c
+
+
+def read_png(path):
+	with open(path, 'rb') as f:
+		data = f.read()
+	if data[:8] != PNG_SIGNATURE:
+		raise ValueError('%s: not a png file' % path)
+
+	pos = 8
+	idat = bytearray()
+	while pos < len(data):
+		size, kind = struct.unpack('>I4s', data[pos:pos + 8])
+		chunk = data[pos + 8:pos + 8 + size]
+		pos += size + 12
+		if kind == b'IHDR':
+			width, height, depth, color, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+		elif kind == b'IDAT':
+			idat += chunk
+		elif kind == b'IEND':
+			break
+
+	if depth != 8 or color not in (2, 6) or interlace:
+		raise ValueError('%s: only 8 bits non-interlaced RGB(A) images are supported' % path)
+
+	bpp = 4 if color == 6 else 3
+	stride = width * bpp
+	raw = zlib.decompress(bytes(idat))
+
+	image = Image(width, height)
+	prev = bytearray(stride)
+	for y in range(height):
+		start = y * (stride + 1)
+		kind = raw[start]
+		line = bytearray(raw[start + 1:start + 1 + stride])
+		if kind == 1:
+			for i in range(bpp, stride):
+				line[i] = (line[i] + line[i - bpp]) & 0xff
+		elif kind == 2:
+			for i in range(stride):
+				line[i] = (line[i] + prev[i]) & 0xff
+		elif kind == 3:
+			for i in range(stride):
+				left = line[i - bpp] if i >= bpp else 0
+				line[i] = (line[i] + ((left + prev[i]) >> 1)) & 0xff
+		elif kind == 4:
+			for i in range(stride):
+				left = line[i - bpp] if i >= bpp else 0
+				upLeft = prev[i - bpp] if i >= bpp else 0
+				line[i] = (line[i] + paeth(left, prev[i], upLeft)) & 0xff
+		prev = line
+
+		if bpp == 4:
+			image.rows[y][:] = line
+		else:
+			row = image.rows[y]
+			for x in range(width):
+				row[x * 4:x * 4 + 3] = line[x * 3:x * 3 + 3]
+				row[x * 4 + 3] = 0xff
+
+	return image
+
+
+def write_png(path, image):
+	def chunk(kind, payload):
+		crc = zlib.crc32(kind + payload) & 0xffffffff
+		return struct.pack('>I', len(payload)) + kind + payload + struct.pack('>I', crc)
+
+	raw = bytearray()
+	for row in image.rows:
+		raw.append(0)
+		raw += row
+
+	with open(path, 'wb') as f:
+		f.write(PNG_SIGNATURE)
+		f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', image.width, image.height, 8, 6, 0, 0, 0)))
+		f.write(chunk(b'IDAT', zlib.compress(bytes(raw), 9)))
+		f.write(chunk(b'IEND', b''))
+
+
+def shelf_pack(sizes, width):
+	"""Place rectangles of the given sizes on shelves of the given width.
+	Returns the positions and the height used, or None if one does not fit."""
+	order = sorted(range(len(sizes)), key=lambda i: (-sizes[i][1], -sizes[i][0]))
+	positions = [ None ] * len(sizes)
+	x = y = shelf = 0
+	for i in order:
+		w, h = sizes[i]
+		if w > width:
+			return None, 0
+		if x + w > width:
+			x = 0
+			y += shelf
+			shelf = 0
+		positions[i] = (x, y)
+		x += w
+		shelf = max(shelf, h)
+	return positions, y + shelf
+
+
+def pack(sizes):
+	"""Find the smallest power of two atlas that holds all the rectangles."""
+	best = None
+	width = 1
+	while width <= MAX_SIZE:
+		positions, used = shelf_pack(sizes, width)
+		if positions is not None:
+			height = 1
+			while height < used:
+				height *= 2
+			if height <= MAX_SIZE and (best is None or width * height < best[0] * best[1]):
+				best = (width, height, positions)
+		width *= 2
+	return best
+
+
+def blit(atlas, image, x0, y0):
+	"""Copy image at (x0 + 1, y0 + 1) and extrude its border by one pixel."""
+	for y in range(-1, image.height + 1):
+		src = image.rows[min(max(y, 0), image.height - 1)]
+		dst = atlas.rows[y0 + 1 + y]
+		left = (x0 + 1) * 4
+		dst[left:left + image.width * 4] = src
+		dst[left - 4:left] = src[0:4]
+		dst[left + image.width * 4:left + image.width * 4 + 4] = src[-4:]
+
+
+def main():
+	parser = argparse.ArgumentParser(description='Pack images into a texture atlas.')
+	parser.add_argument('-d', '--assets', default=os.path.join(os.path.dirname(__file__), '..', 'assets'),
+	                    help='the assets directory')
+	parser.add_argument('name', help='the name of the atlas, without extension')
+	parser.add_argument('images', nargs='+', help='the images to pack, relative to the assets directory')
+	args = parser.parse_args()
+
+	images = [ read_png(os.path.join(args.assets, name)) for name in args.images ]
+	sizes = [ (image.width + 2, image.height + 2) for image in images ]
+
+	packed = pack(sizes)
+	if packed is None:
+		print('Images do not fit in a %dx%d atlas.' % (MAX_SIZE, MAX_SIZE), file=sys.stderr)
+		return 1
+	width, height, positions = packed
+
+	atlas = Image(width, height)
+	for image, (x, y) in zip(images, positions):
+		blit(atlas, image, x, y)
+	write_png(os.path.join(args.assets, args.name + '.png'), atlas)
+
+	with open(os.path.join(args.assets, args.name + '.ldl'), 'w') as f:
+		f.write('// Generated by tools/pack_atlas.py, do not edit.\n')
+		f.write('// Rectangles are [ image, x, y, width, height ] in pixels from the top-left.\n\n')
+		f.write("texture = '%s.png'\n" % args.name)
+		f.write('size = [ %d, %d ]\n\n' % (width, height))
+		f.write('images = [\n')
+		for name, image, (x, y) in zip(args.images, images, positions):
+			f.write("\t[ '%s', %d, %d, %d, %d ]\n" % (name, x + 1, y + 1, image.width, image.height))
+		f.write(']\n')
+
+	print('Packed %d images in %s.png (%dx%d).' % (len(images), args.name, width, height))
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())